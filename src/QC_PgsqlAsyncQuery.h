@@ -0,0 +1,72 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QC_PgsqlAsyncQuery.h
+
+    Qore Programming Language
+
+    Copyright 2003 - 2022 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _QORE_PGSQL_QC_PGSQLASYNCQUERY_H
+#define _QORE_PGSQL_QC_PGSQLASYNCQUERY_H
+
+#include "QC_PgsqlConnection.h"
+
+DLLLOCAL extern qore_classid_t CID_PGSQLASYNCQUERY;
+DLLLOCAL extern QoreClass* QC_PGSQLASYNCQUERY;
+
+DLLLOCAL QoreClass* initPgsqlAsyncQueryClass(QoreNamespace& ns);
+
+// private data for PgsqlAsyncQuery objects; all calls are serialized on the PgsqlConnection's lock
+class QorePgsqlAsyncQueryData : public AbstractPrivateData {
+public:
+    DLLLOCAL QorePgsqlAsyncQueryData(QorePgsqlConnectionData* pc) : pc(pc) {
+        pc->ref();
+    }
+
+    // sends the query; returns 0 for OK, -1 for error
+    DLLLOCAL int start(const QoreString& sql, const QoreListNode* args, ExceptionSink* xsink);
+
+    DLLLOCAL int poll(ExceptionSink* xsink);
+    DLLLOCAL int wait(int64 timeout_ms, ExceptionSink* xsink);
+    DLLLOCAL QoreValue getResult(int64 timeout_ms, ExceptionSink* xsink);
+    DLLLOCAL QoreListNode* getRows(int64 timeout_ms, ExceptionSink* xsink);
+    DLLLOCAL void abort();
+
+    DLLLOCAL virtual void deref(ExceptionSink* xsink) {
+        if (ROdereference()) {
+            abort();
+            pc->deref(xsink);
+            delete this;
+        }
+    }
+
+protected:
+    QorePgsqlConnectionData* pc;
+    std::unique_ptr<QorePgsqlAsyncQuery> query;
+    // the serial of the connection the query was sent on
+    unsigned conn_serial = 0;
+
+    DLLLOCAL virtual ~QorePgsqlAsyncQueryData() {
+    }
+
+    // returns the query if the connection has not been closed since it was sent, otherwise raises an exception;
+    // the lock must be held
+    DLLLOCAL QorePgsqlAsyncQuery* getQuery(ExceptionSink* xsink);
+};
+
+#endif
@@ -0,0 +1,161 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QC_PgsqlConnection.h
+
+    Qore Programming Language
+
+    Copyright 2003 - 2022 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _QORE_PGSQL_QC_PGSQLCONNECTION_H
+#define _QORE_PGSQL_QC_PGSQLCONNECTION_H
+
+#include "pgsql.h"
+#include "QorePGConnection.h"
+
+DLLLOCAL extern qore_classid_t CID_PGSQLCONNECTION;
+DLLLOCAL extern QoreClass* QC_PGSQLCONNECTION;
+
+DLLLOCAL QoreClass* initPgsqlConnectionClass(QoreNamespace& ns);
+
+DLLLOCAL extern DBIDriver* DBID_PGSQL;
+
+// private data for PgsqlConnection objects; holds a dedicated connection for PostgreSQL-specific APIs
+class QorePgsqlConnectionData : public AbstractPrivateData {
+public:
+    DLLLOCAL QorePgsqlConnectionData() : ds(DBID_PGSQL) {
+    }
+
+    // parses the connection string and opens the connection; returns 0 for OK, -1 for error
+    DLLLOCAL int init(const QoreString& connstr, ExceptionSink* xsink);
+
+    DLLLOCAL QoreValue exec(const QoreString* sql, const QoreListNode* args, ExceptionSink* xsink) {
+        AutoLocker al(m);
+        return ds.exec(sql, args, xsink);
+    }
+
+    DLLLOCAL QoreValue select(const QoreString* sql, const QoreListNode* args, ExceptionSink* xsink) {
+        AutoLocker al(m);
+        return ds.select(sql, args, xsink);
+    }
+
+    DLLLOCAL QoreValue selectRows(const QoreString* sql, const QoreListNode* args, ExceptionSink* xsink) {
+        AutoLocker al(m);
+        return ds.selectRows(sql, args, xsink);
+    }
+
+    DLLLOCAL QoreHashNode* selectRow(const QoreString* sql, const QoreListNode* args, ExceptionSink* xsink) {
+        AutoLocker al(m);
+        return ds.selectRow(sql, args, xsink);
+    }
+
+    DLLLOCAL int64 selectToStream(OutputStream* os, const QoreString* sql, const QoreListNode* args,
+            ExceptionSink* xsink);
+
+    DLLLOCAL int beginTransaction(ExceptionSink* xsink) {
+        AutoLocker al(m);
+        return ds.beginTransaction(xsink);
+    }
+
+    DLLLOCAL int commit(ExceptionSink* xsink) {
+        AutoLocker al(m);
+        return ds.commit(xsink);
+    }
+
+    DLLLOCAL int rollback(ExceptionSink* xsink) {
+        AutoLocker al(m);
+        return ds.rollback(xsink);
+    }
+
+    DLLLOCAL int setOption(const char* opt, const QoreValue val, ExceptionSink* xsink) {
+        AutoLocker al(m);
+        return ds.setOption(opt, val, xsink);
+    }
+
+    DLLLOCAL QoreValue getOption(const char* opt, ExceptionSink* xsink) {
+        AutoLocker al(m);
+        return ds.getOption(opt, xsink);
+    }
+
+    DLLLOCAL int addBatch(const QoreString* sql, const QoreListNode* args, ExceptionSink* xsink);
+    DLLLOCAL QoreListNode* execBatch(bool commit, ExceptionSink* xsink);
+    DLLLOCAL size_t getBatchSize();
+    DLLLOCAL void discardBatch();
+
+    DLLLOCAL int listen(const QoreString& channel, ExceptionSink* xsink);
+    DLLLOCAL int unlisten(const QoreString* channel, ExceptionSink* xsink);
+    DLLLOCAL QoreListNode* getNotifications(int64 timeout_ms, ExceptionSink* xsink);
+    // sends notifications given as hashes with "channel" and "payload" keys in a single command; returns 0 for OK,
+    // -1 for error
+    DLLLOCAL int notify(const QoreListNode* notifications, ExceptionSink* xsink);
+
+    // sends a cancel request for the command in progress; does not take the connection lock so that it can be
+    // called while another thread is executing a command on the connection
+    DLLLOCAL void cancel();
+
+    // returns the lock serializing access to the connection
+    DLLLOCAL QoreThreadLock& getLock() {
+        return m;
+    }
+
+    // returns the driver connection, opening it if necessary; the lock must be held
+    DLLLOCAL QorePGConnection* getConnection(ExceptionSink* xsink);
+
+    // returns the driver connection or nullptr if the connection is closed; the lock must be held
+    DLLLOCAL QorePGConnection* getOpenConnection() const {
+        return ds.isOpen() ? (QorePGConnection*)ds.getPrivateData() : nullptr;
+    }
+
+    // returns the driver connection if it's open and is the connection with the given serial, otherwise nullptr;
+    // never opens the connection; the lock must be held
+    DLLLOCAL QorePGConnection* getOpenConnection(unsigned serial) const {
+        return serial == conn_serial ? getOpenConnection() : nullptr;
+    }
+
+    // returns the serial of the current connection; incremented every time the connection is opened, so objects
+    // bound to a connection can tell if it has been closed and opened again; the lock must be held
+    DLLLOCAL unsigned getConnectionSerial() const {
+        return conn_serial;
+    }
+
+    // starts a transaction if necessary as with Datasource::exec(); the lock must be held
+    DLLLOCAL int beginImplicitTransaction(ExceptionSink* xsink);
+
+    DLLLOCAL const QoreEncoding* getEncoding() const {
+        return ds.getQoreEncoding();
+    }
+
+protected:
+    Datasource ds;
+    // serializes access to the connection
+    QoreThreadLock m;
+    // the cancel handle of the current connection; replaced when the connection is opened
+    qore_pg_cancel_t cancel_handle;
+    // serializes access to cancel_handle; only held to copy or replace the handle
+    QoreThreadLock cancel_lock;
+    // the serial of the current connection
+    unsigned conn_serial = 0;
+
+    // opens the connection and updates the cancel handle; the lock must be held
+    DLLLOCAL int open(ExceptionSink* xsink);
+
+    DLLLOCAL virtual ~QorePgsqlConnectionData() {
+        ds.close();
+    }
+};
+
+#endif
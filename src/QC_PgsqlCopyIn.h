@@ -0,0 +1,73 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QC_PgsqlCopyIn.h
+
+    Qore Programming Language
+
+    Copyright 2003 - 2022 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _QORE_PGSQL_QC_PGSQLCOPYIN_H
+#define _QORE_PGSQL_QC_PGSQLCOPYIN_H
+
+#include "QC_PgsqlConnection.h"
+
+DLLLOCAL extern qore_classid_t CID_PGSQLCOPYIN;
+DLLLOCAL extern QoreClass* QC_PGSQLCOPYIN;
+
+DLLLOCAL QoreClass* initPgsqlCopyInClass(QoreNamespace& ns);
+
+// private data for PgsqlCopyIn objects; all calls are serialized on the PgsqlConnection's lock
+class QorePgsqlCopyInData : public AbstractPrivateData {
+public:
+    DLLLOCAL QorePgsqlCopyInData(QorePgsqlConnectionData* pc) : pc(pc) {
+        pc->ref();
+    }
+
+    // starts the COPY; returns 0 for OK, -1 for error
+    DLLLOCAL int start(const QoreString& table, const QoreListNode* columns, ExceptionSink* xsink);
+
+    DLLLOCAL int addRow(const QoreListNode& row, ExceptionSink* xsink);
+    DLLLOCAL int addRow(const QoreHashNode& row, ExceptionSink* xsink);
+    DLLLOCAL int addRows(const QoreListNode& rows, ExceptionSink* xsink);
+    DLLLOCAL int64 finish(ExceptionSink* xsink);
+    DLLLOCAL void abort(const char* msg);
+    DLLLOCAL int64 getRowCount();
+    DLLLOCAL bool active();
+
+    DLLLOCAL virtual void deref(ExceptionSink* xsink) {
+        if (ROdereference()) {
+            abort("COPY aborted; the PgsqlCopyIn object was deleted");
+            pc->deref(xsink);
+            delete this;
+        }
+    }
+
+protected:
+    QorePgsqlConnectionData* pc;
+    std::unique_ptr<QorePgsqlCopyIn> copy;
+    // the serial of the connection the COPY was started on
+    unsigned conn_serial = 0;
+
+    DLLLOCAL virtual ~QorePgsqlCopyInData() {
+    }
+
+    // returns the COPY if it's still in progress on the current connection; the lock must be held
+    DLLLOCAL QorePgsqlCopyIn* getActiveCopy();
+};
+
+#endif
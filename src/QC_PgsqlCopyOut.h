@@ -0,0 +1,71 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QC_PgsqlCopyOut.h
+
+    Qore Programming Language
+
+    Copyright 2003 - 2022 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _QORE_PGSQL_QC_PGSQLCOPYOUT_H
+#define _QORE_PGSQL_QC_PGSQLCOPYOUT_H
+
+#include "QC_PgsqlConnection.h"
+
+DLLLOCAL extern qore_classid_t CID_PGSQLCOPYOUT;
+DLLLOCAL extern QoreClass* QC_PGSQLCOPYOUT;
+
+DLLLOCAL QoreClass* initPgsqlCopyOutClass(QoreNamespace& ns);
+
+// private data for PgsqlCopyOut objects; all calls are serialized on the PgsqlConnection's lock
+class QorePgsqlCopyOutData : public AbstractPrivateData {
+public:
+    DLLLOCAL QorePgsqlCopyOutData(QorePgsqlConnectionData* pc) : pc(pc) {
+        pc->ref();
+    }
+
+    // starts the COPY; returns 0 for OK, -1 for error
+    DLLLOCAL int start(const QoreString& query, ExceptionSink* xsink);
+
+    DLLLOCAL QoreListNode* fetchRows(int rows, ExceptionSink* xsink);
+    DLLLOCAL QoreHashNode* fetchColumns(int rows, ExceptionSink* xsink);
+    DLLLOCAL void abort();
+    DLLLOCAL int64 getRowCount();
+    DLLLOCAL bool active();
+
+    DLLLOCAL virtual void deref(ExceptionSink* xsink) {
+        if (ROdereference()) {
+            abort();
+            pc->deref(xsink);
+            delete this;
+        }
+    }
+
+protected:
+    QorePgsqlConnectionData* pc;
+    std::unique_ptr<QorePgsqlCopyOut> copy;
+    // the serial of the connection the COPY was started on
+    unsigned conn_serial = 0;
+
+    DLLLOCAL virtual ~QorePgsqlCopyOutData() {
+    }
+
+    // returns the COPY if it's still in progress on the current connection; the lock must be held
+    DLLLOCAL QorePgsqlCopyOut* getActiveCopy();
+};
+
+#endif
@@ -0,0 +1,103 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QC_PgsqlLargeObject.h
+
+    Qore Programming Language
+
+    Copyright 2003 - 2022 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _QORE_PGSQL_QC_PGSQLLARGEOBJECT_H
+#define _QORE_PGSQL_QC_PGSQLLARGEOBJECT_H
+
+#include "QC_PgsqlConnection.h"
+
+#include <qore/InputStream.h>
+#include <qore/OutputStream.h>
+
+DLLLOCAL extern qore_classid_t CID_PGSQLLARGEOBJECT;
+DLLLOCAL extern QoreClass* QC_PGSQLLARGEOBJECT;
+
+DLLLOCAL QoreClass* initPgsqlLargeObjectClass(QoreNamespace& ns);
+
+// the default number of bytes transferred with each call when streaming large object data
+#define QORE_PG_LOB_CHUNK_SIZE (256 * 1024)
+
+// private data for PgsqlLargeObject objects; all calls are serialized on the PgsqlConnection's lock
+class QorePgsqlLargeObjectData : public AbstractPrivateData {
+public:
+    DLLLOCAL QorePgsqlLargeObjectData(QorePgsqlConnectionData* pc) : pc(pc) {
+        pc->ref();
+    }
+
+    // opens the large object with the given OID, or creates a new large object if oid is InvalidOid; returns 0 for
+    // OK, -1 for error
+    DLLLOCAL int open(Oid oid, bool write, ExceptionSink* xsink);
+
+    DLLLOCAL Oid getOid() const {
+        return oid;
+    }
+
+    // reads at most size bytes; returns nullptr at the end of the data or for errors
+    DLLLOCAL BinaryNode* read(int64 size, ExceptionSink* xsink);
+    // returns the number of bytes written or -1 for error
+    DLLLOCAL int64 write(const BinaryNode& data, ExceptionSink* xsink);
+    // returns the new position or -1 for error
+    DLLLOCAL int64 seek(int64 offset, int whence, ExceptionSink* xsink);
+    // returns the size of the large object or -1 for error; the position is not changed
+    DLLLOCAL int64 size(ExceptionSink* xsink);
+    DLLLOCAL int truncate(int64 len, ExceptionSink* xsink);
+
+    // writes the data from the current position to the end of the large object to the stream in chunks; returns the
+    // number of bytes written or -1 for error
+    DLLLOCAL int64 readToStream(OutputStream* os, int64 chunk_size, ExceptionSink* xsink);
+    // writes all data from the stream to the large object in chunks; returns the number of bytes written or -1 for
+    // error
+    DLLLOCAL int64 writeFromStream(InputStream* is, int64 chunk_size, ExceptionSink* xsink);
+
+    DLLLOCAL int close(ExceptionSink* xsink);
+
+    // deletes the large object with the given OID; returns 0 for OK, -1 for error
+    DLLLOCAL static int unlink(QorePgsqlConnectionData* pc, Oid oid, ExceptionSink* xsink);
+
+    DLLLOCAL virtual void deref(ExceptionSink* xsink) {
+        if (ROdereference()) {
+            // the large object is closed in any case when the transaction ends
+            ExceptionSink xsink2;
+            close(&xsink2);
+            xsink2.clear();
+            pc->deref(xsink);
+            delete this;
+        }
+    }
+
+protected:
+    QorePgsqlConnectionData* pc;
+    // the transaction the large object was opened in
+    unsigned trans_serial = 0;
+    Oid oid = InvalidOid;
+    // the large object descriptor
+    int fd = -1;
+
+    DLLLOCAL virtual ~QorePgsqlLargeObjectData() {
+    }
+
+    // returns the connection if the large object is still open, otherwise raises an exception; the lock must be held
+    DLLLOCAL QorePGConnection* getOpenConnection(ExceptionSink* xsink);
+};
+
+#endif
@@ -24,19 +24,26 @@
 #include "pgsql.h"
 
 #include "QorePGConnection.h"
+#include "QorePGHandlePool.h"
 
 #if (defined _WIN32 || defined __WIN32__) && ! defined __CYGWIN__
 #include <winsock2.h>
 #else
 #include <sys/socket.h>
+#include <poll.h>
 #endif
 
+#include <errno.h>
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
 
+#include <algorithm>
+#include <unordered_set>
 #include <memory>
+#include <limits>
 #include <typeinfo>
+#include <chrono>
 
 // postgresql uses an epoch starting at 2000-01-01, which is
 // 10,957 days after the UNIX and Qore epoch of 1970-01-01
@@ -44,9 +51,11 @@
 #define PGSQL_EPOCH_OFFSET (10957 * 86400)
 
 // declare static members
-qore_pg_data_map_t QorePgsqlStatement::data_map;
-qore_pg_array_data_map_t QorePgsqlStatement::array_data_map;
+QorePgsqlDecoderTable QorePgsqlStatement::decoder_tables[4];
 qore_pg_array_type_map_t QorePgsqlStatement::array_type_map;
+QorePgsqlSqlTemplateCache QorePgsqlStatement::template_cache;
+QorePgsqlReconnectBackoff QorePGConnection::reconnect_backoff_map;
+std::atomic<unsigned> QorePGConnection::trans_seq(0);
 
 #ifdef DEBUG
 void do_output(char* p, unsigned len) {
@@ -55,175 +64,304 @@ void do_output(char* p, unsigned len) {
 }
 #endif
 
-void qore_pg_numeric::convertToHost() {
-    ndigits = ntohs(ndigits);
-    weight = ntohs(weight);
-    sign = ntohs(sign);
-    dscale = ntohs(dscale);
-
-#ifdef DEBUG_1
-    printd(0, "qpg_data_numeric::convertToHost() ndigits: %hd weight: %hd sign: %hd dscale: %hd\n", ndigits, weight, sign, dscale);
-    for (unsigned i = 0; i < ndigits; ++i)
-        printd(0, " + %hu\n", ntohs(digits[i]));
-#endif
+// writes the 4 decimal digits of a NUMERIC digit group
+static inline char* qore_pg_numeric_group(char* p, unsigned d) {
+    p[3] = '0' + d % 10;
+    d /= 10;
+    p[2] = '0' + d % 10;
+    d /= 10;
+    p[1] = '0' + d % 10;
+    p[0] = '0' + d / 10;
+    return p + 4;
 }
 
-QoreValue qore_pg_numeric::toOptimal() const {
-    QoreString str;
-    toStr(str);
-
-    //printd(5, "qore_pg_numeric::toOptimal() processing %s ndigits: %d weight: %d sign: %d cmp: %d\n", str.c_str(), ndigits, weight, sign, strcmp(str.c_str(), "-9223372036854775808"));
+const char* qore_pg_numeric::getSpecial() const {
+    switch (ntohs(sign)) {
+        case QORE_PG_NUMERIC_NAN: return "NaN";
+        case QORE_PG_NUMERIC_PINF: return "Infinity";
+        case QORE_PG_NUMERIC_NINF: return "-Infinity";
+    }
+    return nullptr;
+}
 
-    // return an integer if the number can be converted to a 64-bit integer
-    if ((ndigits <= (weight + 1)) && (ndigits < 4
-                    || (ndigits == 5 &&
-                        ((!sign && strcmp(str.c_str(), "9223372036854775807") <= 0)
-                        ||(sign && strcmp(str.c_str(), "-9223372036854775808") <= 0)))))
-        return str.toBigInt();
+bool qore_pg_numeric::toBigInt(int64& v) const {
+    int nd = (short)ntohs(ndigits);
+    int w = (short)ntohs(weight);
+    unsigned s = ntohs(sign);
+    if (s != QORE_PG_NUMERIC_POS && s != QORE_PG_NUMERIC_NEG)
+        return false;
+    if (!nd) {
+        v = 0;
+        return true;
+    }
+    // there are digits after the decimal point
+    if (w < 0 || nd > w + 1)
+        return false;
 
-    return new QoreNumberNode(str.c_str());
+    bool neg = s == QORE_PG_NUMERIC_NEG;
+    uint64_t limit = neg ? (uint64_t)LLONG_MAX + 1 : (uint64_t)LLONG_MAX;
+    uint64_t m = 0;
+    for (int i = 0; i <= w; ++i) {
+        unsigned d = i < nd ? ntohs(digits[i]) : 0;
+        if (m > (limit - d) / 10000)
+            return false;
+        m = m * 10000 + d;
+    }
+    v = neg ? (int64)(~m + 1) : (int64)m;
+    return true;
 }
 
-QoreStringNode* qore_pg_numeric::toString() const {
-    QoreStringNode* str = new QoreStringNode;
-    toStr(*str);
-    return str;
+size_t qore_pg_numeric::strSize() const {
+    int w = (short)ntohs(weight);
+    int ds = (short)ntohs(dscale);
+    // the sign, the integer digits, the decimal point, the fractional digits, and the terminating null; the text of
+    // NaN and infinite values also fits
+    size_t size = 1 + (w >= 0 ? (w + 1) * 4 : 1) + 1 + (ds > 0 ? ds : 0) + 1;
+    return size < 11 ? 11 : size;
 }
 
-QoreNumberNode* qore_pg_numeric::toNumber() const {
-    QoreString str;
-    toStr(str);
+size_t qore_pg_numeric::toStr(char* buf) const {
+    const char* sp = getSpecial();
+    if (sp) {
+        size_t len = strlen(sp);
+        memcpy(buf, sp, len + 1);
+        return len;
+    }
 
-    return new QoreNumberNode(str.c_str());
-}
+    int nd = (short)ntohs(ndigits);
+    int w = (short)ntohs(weight);
+    int ds = (short)ntohs(dscale);
 
-void qore_pg_numeric::toStr(QoreString& str) const {
-    if (!ndigits) {
-        str.concat('0');
-        return;
+    char* p = buf;
+    if (nd && ntohs(sign) == QORE_PG_NUMERIC_NEG)
+        *p++ = '-';
+
+    // the integer part; the first digit group is written without leading zeros
+    if (w < 0 || !nd) {
+        *p++ = '0';
+    } else {
+        unsigned d = ntohs(digits[0]);
+        char tmp[4];
+        qore_pg_numeric_group(tmp, d);
+        int skip = d >= 1000 ? 0 : (d >= 100 ? 1 : (d >= 10 ? 2 : 3));
+        memcpy(p, tmp + skip, 4 - skip);
+        p += 4 - skip;
+        for (int i = 1; i <= w; ++i)
+            p = qore_pg_numeric_group(p, i < nd ? ntohs(digits[i]) : 0);
     }
 
-    if (sign)
-        str.concat('-');
+    // the fractional part has exactly dscale digits; digit groups before the first group are zero
+    if (ds > 0) {
+        *p++ = '.';
+        int i = nd ? w + 1 : 0;
+        while (ds > 0) {
+            unsigned d = (i >= 0 && i < nd) ? ntohs(digits[i]) : 0;
+            if (ds >= 4) {
+                p = qore_pg_numeric_group(p, d);
+                ds -= 4;
+            } else {
+                char tmp[4];
+                qore_pg_numeric_group(tmp, d);
+                memcpy(p, tmp, ds);
+                p += ds;
+                ds = 0;
+            }
+            ++i;
+        }
+    }
+    *p = '\0';
+    return p - buf;
+}
 
-    //printd(5, "qore_pg_numeric::toStr() ndigits: %d dscale: %d\n", ndigits, dscale);
+QoreValue qore_pg_numeric::toOptimal() const {
+    // return an integer if the number can be converted to a 64-bit integer
+    int64 v;
+    if (toBigInt(v))
+        return v;
+    return toNumber();
+}
 
-    int i;
-    for (i = 0; i < ndigits; ++i) {
-        if (i == weight + 1)
-            str.concat('.');
-        if (i || weight < 0)
-            str.sprintf("%04d", ntohs(digits[i]));
-        else
-            str.sprintf("%d", ntohs(digits[i]));
-        //printd(5, "qore_pg_numeric::toStr() digit %d: %d\n", i, ntohs(digits[i]));
+QoreStringNode* qore_pg_numeric::toString() const {
+    // the string takes ownership of the buffer
+    size_t size = strSize();
+    char* buf = (char*)malloc(size);
+    size_t len = toStr(buf);
+    return new QoreStringNode(buf, len, size, QCS_DEFAULT);
+}
+
+QoreNumberNode* qore_pg_numeric::toNumber() const {
+    switch (ntohs(sign)) {
+        case QORE_PG_NUMERIC_NAN: return new QoreNumberNode(std::numeric_limits<double>::quiet_NaN());
+        case QORE_PG_NUMERIC_PINF: return new QoreNumberNode(std::numeric_limits<double>::infinity());
+        case QORE_PG_NUMERIC_NINF: return new QoreNumberNode(-std::numeric_limits<double>::infinity());
     }
 
-    //printd(5, "qore_pg_numeric::toStr() i: %d weight: %d str: %s\n", i, weight, str.c_str());
+    size_t size = strSize();
+    if (size <= QORE_PG_NUMERIC_BUF_SIZE) {
+        char buf[QORE_PG_NUMERIC_BUF_SIZE];
+        toStr(buf);
+        return new QoreNumberNode(buf);
+    }
+
+    std::unique_ptr<char[]> buf(new char[size]);
+    toStr(buf.get());
+    return new QoreNumberNode(buf.get());
+}
+
+// returns x / 4 rounded towards negative infinity
+static inline int64 qore_pg_group_floor(int64 x) {
+    return x >= 0 ? x / 4 : -((-x + 3) / 4);
+}
 
-    // now add significant zeros for remaining decimal places
-    if (weight >= i)
-        str.addch('0', (weight - i + 1) * 4);
-    else if (weight < -1) {
-        for (int i = weight; i < -1; ++i)
-            str.insert("0000", 0);
-        str.prepend(".");
+uint16_t* qore_pg_numeric_out::alloc(int n) {
+    ndigits = n;
+    uint16_t* p = buf;
+    if (n > QORE_PG_NUMERIC_OUT_INLINE) {
+        heap.reset(new uint16_t[4 + n]);
+        p = heap.get();
     }
+    memset(p + 4, 0, n * sizeof(uint16_t));
+    return p + 4;
+}
 
-    //printd(5, "qore_pg_numeric::toStr() str: '%s'\n", str.c_str());
+void qore_pg_numeric_out::finish(int weight, int sign, int dscale) {
+    uint16_t* p = heap ? heap.get() : buf;
+    printd(5, "qore_pg_numeric_out::finish() ndigits: %d weight: %d sign: %d dscale: %d\n", ndigits, weight, sign,
+        dscale);
+    p[0] = htons((uint16_t)ndigits);
+    p[1] = htons((uint16_t)(int16_t)weight);
+    p[2] = htons((uint16_t)sign);
+    p[3] = htons((uint16_t)dscale);
+    for (int i = 0; i < ndigits; ++i)
+        p[4 + i] = htons(p[4 + i]);
 }
 
-size_t qore_pg_numeric::rawSize() const {
-    return sizeof(qore_pg_numeric_base) + sizeof(short) * ntohs(ndigits);
+qore_pg_numeric_out::qore_pg_numeric_out(int64 i) {
+    uint64_t m = i < 0 ? ~(uint64_t)i + 1 : (uint64_t)i;
+    // the digit groups with the least significant group first
+    uint16_t g[5];
+    int n = 0;
+    while (m) {
+        g[n++] = m % 10000;
+        m /= 10000;
+    }
+    // trailing zero groups are not sent
+    int skip = 0;
+    while (skip < n && !g[skip])
+        ++skip;
+    uint16_t* d = alloc(n - skip);
+    for (int j = 0; j < n - skip; ++j)
+        d[j] = g[n - 1 - j];
+    finish(n ? n - 1 : 0, i < 0 ? QORE_PG_NUMERIC_NEG : QORE_PG_NUMERIC_POS, 0);
 }
 
-qore_pg_numeric_out::qore_pg_numeric_out(const QoreNumberNode* n) {
+int qore_pg_numeric_out::set(const QoreNumberNode* n, ExceptionSink* xsink) {
     QoreString str;
     n->getStringRepresentation(str);
+    return set(str.c_str(), str.size(), xsink);
+}
 
-    //printd(5, "qore_pg_numeric_out::qore_pg_numeric_out() this %p str: '%s'\n", this, str.c_str());
-
-    // populate structure
-    int nsign = n->sign();
-    if (nsign < 0) {
-        // this is what the server sends for negative numbers
-        sign = 0x4000;
-        // remove the minus sign from the string
-        str.trim_leading('-');
-    }
-    qore_offset_t di = str.find('.');
-    if (di == -1)
-        di = str.strlen();
-
-    //printd(5, "find: '%s' di: %lld\n", str.c_str(), di);
-
-    char buf[5];
-    int i = 0;
-    if (di != 1 || str[0] != '0') {
-        while (i < di) {
-            // get the remaining number of digits up to the decimal place
-            int nd = (di - i) % 4;
-            if (!nd)
-                nd = 4;
-            for (int j = 0; j < nd; ++j)
-                buf[j] = (str.c_str() + i)[j];
-            buf[nd] = '\0';
-            digits[ndigits++] = atoi(buf);
-            if (ndigits > 1)
-                ++weight;
-            //printd(5, "adding digits: '%s' (%d)\n", buf, atoi(buf));
-            i += nd;
-        }
-    } else {
-        weight = -1;
-        i = 1;
+int qore_pg_numeric_out::set(const char* str, size_t len, ExceptionSink* xsink) {
+    const char* p = str;
+    const char* e = str + len;
+    bool neg = false;
+    if (p < e && (*p == '-' || *p == '+')) {
+        neg = *p == '-';
+        ++p;
     }
 
-    // now add digits after the decimal point
-    if (i != (int)str.size()) {
-        // skip decimal point
-        ++i;
-        di = str.size();
-        while (i < di) {
-            int nd = di - i;
-            dscale += nd;
-            if (nd > 4)
-                nd = 4;
-            for (int j = 0; j < nd; ++j)
-                buf[j] = (str.c_str() + i)[j];
-            while (nd < 4)
-                buf[nd++] = '0';
-            buf[nd] = '\0';
-            digits[ndigits++] = atoi(buf);
-            //printd(5, "adding (after decimal point) digits: '%s' (%d)\n", buf, atoi(buf));
-            i += 4;
+    // find the digits and the position of the decimal point
+    const char* digits = p;
+    int64 nd = 0;
+    int64 before = -1;
+    for (; p < e; ++p) {
+        if (*p >= '0' && *p <= '9')
+            ++nd;
+        else if (*p == '.' && before < 0)
+            before = nd;
+        else
+            break;
+    }
+    if (before < 0)
+        before = nd;
+
+    int64 exp = 0;
+    bool bad = false;
+    if (nd && p < e && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool eneg = false;
+        if (p < e && (*p == '-' || *p == '+')) {
+            eneg = *p == '-';
+            ++p;
         }
-    } else if (ndigits) {
-        // trim off trailing zeros when there are no digits after the decimal point
-        while (!digits[ndigits - 1]) {
-            --ndigits;
+        const char* es = p;
+        for (; p < e && *p >= '0' && *p <= '9'; ++p) {
+            if (exp < 1000000000)
+                exp = exp * 10 + (*p - '0');
         }
+        if (p == es)
+            bad = true;
+        else if (eneg)
+            exp = -exp;
     }
 
-    convertToNet();
-}
+    if (!nd || bad || p != e) {
+        if (!strncasecmp(digits, "nan", 3) || !strncasecmp(digits, "@nan@", 5)) {
+            alloc(0);
+            finish(0, QORE_PG_NUMERIC_NAN, 0);
+            return 0;
+        }
+        if (!strncasecmp(digits, "inf", 3) || !strncasecmp(digits, "@inf@", 5)) {
+            alloc(0);
+            finish(0, neg ? QORE_PG_NUMERIC_NINF : QORE_PG_NUMERIC_PINF, 0);
+            return 0;
+        }
+        xsink->raiseException("DBI:PGSQL:BIND-ERROR", "cannot convert '%s' to a numeric value", str);
+        return -1;
+    }
 
-void qore_pg_numeric_out::convertToNet() {
-    size = sizeof(short) * (4 + ndigits);
+    // the number of digits before the decimal point and the exact scale of the value
+    int64 pt = before + exp;
+    int64 dscale = nd > pt ? nd - pt : 0;
+
+    auto digit = [&] (int64 k) -> int {
+        return digits[k < before ? k : k + 1] - '0';
+    };
+
+    // skip leading and trailing zeros
+    int64 first = 0;
+    while (first < nd && !digit(first))
+        ++first;
+    int64 last = nd;
+    while (last > first && !digit(last - 1))
+        --last;
+
+    // the weights of the first and last digit groups
+    int64 weight = 0, lweight = 0;
+    if (first < last) {
+        weight = qore_pg_group_floor(pt - 1 - first);
+        lweight = qore_pg_group_floor(pt - last);
+    }
+    if (dscale > QORE_PG_NUMERIC_DSCALE_MAX || weight > SHRT_MAX || lweight < SHRT_MIN) {
+        xsink->raiseException("DBI:PGSQL:BIND-ERROR", "number '%s' is out of the range of the numeric type", str);
+        return -1;
+    }
 
-    printd(5, "qore_pg_numeric_out::convertToNet() ndigits: %hd weight: %hd sign: %hd dscale: %hd size: %d\n",
-        ndigits, weight, sign, dscale, size);
-    assert(ndigits >= 0 && ndigits < QORE_MAX_DIGITS);
-    for (unsigned i = 0; i < (unsigned)ndigits; ++i) {
-        //printd(5, " + %hu\n", digits[i]);
-        digits[i] = htons(digits[i]);
+    if (first == last) {
+        alloc(0);
+        finish(0, QORE_PG_NUMERIC_POS, dscale);
+        return 0;
     }
-    ndigits = htons(ndigits);
-    weight = htons(weight);
-    sign = htons(sign);
-    dscale = htons(dscale);
 
-    //do_output((char*)this, size);
+    static const uint16_t pow10[] = {1, 10, 100, 1000};
+    uint16_t* d = alloc(weight - lweight + 1);
+    for (int64 k = first; k < last; ++k) {
+        int64 x = pt - 1 - k;
+        int64 g = qore_pg_group_floor(x);
+        d[weight - g] += digit(k) * pow10[x - g * 4];
+    }
+    finish(weight, neg ? QORE_PG_NUMERIC_NEG : QORE_PG_NUMERIC_POS, dscale);
+    return 0;
 }
 
 // bind functions
@@ -288,107 +426,87 @@ static QoreValue qpg_data_reltime(char* data, int type, int len, QorePGConnectio
     return new DateTimeNode(0, 0, 0, 0, 0, val, 0, true);
 }
 
-static QoreValue qpg_data_timestamptz(char* data, int type, int len, QorePGConnection* conn, const QoreEncoding* enc) {
-    if (conn->has_integer_datetimes()) {
+// the date/time decoders are specialized for the binary format of the server, so values are decoded without checking
+// the format for each value
+template <bool integer>
+static inline void qore_pg_split_time(char* data, int64& secs, int& us) {
+    if (integer) {
         int64 val = MSBi8(*((uint64_t *)data));
-        int64 secs = val / 1000000;
-        int us = val % 1000000;
-        secs += PGSQL_EPOCH_OFFSET;
-        return DateTimeNode::makeAbsolute(conn->getTZ(), secs, us);
+        secs = val / 1000000;
+        us = val % 1000000;
+    } else {
+        double val = MSBf8(*((double *)data));
+        secs = (int64)val;
+        us = (int)((val - (double)secs) * 1000000.0);
     }
-    double fv = MSBf8(*((double *)data));
-    int64 nv = (int64)fv;
-    int us = (int)((fv - (double)nv) * 1000000.0);
-    nv += PGSQL_EPOCH_OFFSET;
-    return DateTimeNode::makeAbsolute(conn->getTZ(), nv, us);
 }
 
-static QoreValue qpg_data_timestamp(char* data, int type, int len, QorePGConnection* conn, const QoreEncoding* enc) {
-    if (conn->has_integer_datetimes()) {
-        int64 val = MSBi8(*((uint64_t *)data));
+template <bool integer>
+static QoreValue qpg_data_timestamptz(char* data, int type, int len, QorePGConnection* conn, const QoreEncoding* enc) {
+    int64 secs;
+    int us;
+    qore_pg_split_time<integer>(data, secs, us);
+    secs += PGSQL_EPOCH_OFFSET;
+    return DateTimeNode::makeAbsolute(conn->getTZ(), secs, us);
+}
 
-        // convert from u-secs to seconds and milliseconds
-        int64 secs = val / 1000000;
-        int us = val % 1000000;
-        secs += PGSQL_EPOCH_OFFSET;
-        return DateTimeNode::makeAbsoluteLocal(conn->getTZ(), secs, us);
-    }
-    double fv = MSBf8(*((double *)data));
-    int64 nv = (int64)fv;
-    int us = (int)((fv - (double)nv) * 1000000.0);
-    nv += PGSQL_EPOCH_OFFSET;
-    return DateTimeNode::makeAbsolute(conn->getTZ(), nv, us);
+template <bool integer>
+static QoreValue qpg_data_timestamp(char* data, int type, int len, QorePGConnection* conn, const QoreEncoding* enc) {
+    // convert from u-secs to seconds and microseconds
+    int64 secs;
+    int us;
+    qore_pg_split_time<integer>(data, secs, us);
+    secs += PGSQL_EPOCH_OFFSET;
+    if (integer)
+        return conn->makeLocalTime(conn->getTZ(), secs, us);
+    return DateTimeNode::makeAbsolute(conn->getTZ(), secs, us);
 }
 
 // the DATEOID format is a signed 32-bit integer giving the day offset from 2000-01-01
 static QoreValue qpg_data_date(char* data, int type, int len, QorePGConnection* conn, const QoreEncoding* enc) {
     int32_t val = ntohl(*((int32_t*)data));
     int64 v = (static_cast<int64>(val) + 10957) * 86400;
-    return new DateTimeNode(v);
+    // dates are returned as midnight in the current time zone
+    return conn->makeLocalTime(currentTZ(), v, 0);
 }
 
+template <bool integer, bool day>
 static QoreValue qpg_data_interval(char* data, int type, int len, QorePGConnection* conn, const QoreEncoding* enc) {
-    int64 secs;
-    int hours;
-    int minutes;
-
     qore_pg_interval *iv = (qore_pg_interval *)data;
     // create interval with microsecond resolution
-    int64 us;
-    if (conn->has_integer_datetimes()) {
-        us = MSBi8(iv->time.i);
-        secs = us / 1000000;
-        us %= 1000000;
-        //printd(5, "got interval %lld: secs: %lld us: %lld (day: %d)\n", MSBi8(iv->time.i), secs, us, conn->has_interval_day());
-    } else {
-        double f = MSBf8(iv->time.f);
-        secs = (int64)f;
-        us = (int)((f - (double)secs) * 1000000.0);
-    }
-    hours = secs / 3600;
+    int64 secs;
+    int us;
+    qore_pg_split_time<integer>((char*)&iv->time, secs, us);
+    int hours = secs / 3600;
     if (hours)
         secs -= hours * 3600;
-    minutes = secs / 60;
+    int minutes = secs / 60;
     if (minutes)
         secs -= minutes* 60;
-    if (conn->has_interval_day())
+    if (day)
         return DateTimeNode::makeRelative(0, ntohl(iv->rest.with_day.month), ntohl(iv->rest.with_day.day), hours, minutes, secs, us);
     return DateTimeNode::makeRelative(0, ntohl(iv->rest.month), 0, hours, minutes, secs, us);
 }
 
+template <bool integer>
 static QoreValue qpg_data_time(char* data, int type, int len, QorePGConnection* conn, const QoreEncoding* enc) {
     int64 secs;
     int us;
-    if (conn->has_integer_datetimes()) {
-        int64 val = MSBi8(*((uint64_t *)data));
-        secs = val / 1000000;
-        us = val % 1000000;
-    } else {
-        double val = MSBf8(*((double *)data));
-        secs = (int64)val;
-        us = (int)((val - (double)secs) * 1000000.0);
-    }
+    qore_pg_split_time<integer>(data, secs, us);
     //printd(5, "qpg_data_time() %lld.%06d\n", secs, us);
     // create the date/time value from an offset in the current time zone
-    return DateTimeNode::makeAbsoluteLocal(conn->getTZ(), secs, us);
+    return conn->makeLocalTime(conn->getTZ(), secs, us);
 }
 
+template <bool integer>
 static QoreValue qpg_data_timetz(char* data, int type, int len, QorePGConnection* conn, const QoreEncoding* enc) {
     qore_pg_time_tz_adt *tm = (qore_pg_time_tz_adt *)data;
-    int64 secs;
     // postgresql gives the time zone in seconds west of UTC
     int zone = ntohl(tm->zone);
 
+    int64 secs;
     int us;
-    if (conn->has_integer_datetimes()) {
-        int64 val = MSBi8(tm->time.i);
-        secs = val / 1000000;
-        us = val % 1000000;
-    } else {
-        double val = MSBf8(tm->time.f);
-        secs = (int64)val;
-        us = (int)((val - (double)secs) * 1000000.0);
-    }
+    qore_pg_split_time<integer>((char*)&tm->time, secs, us);
     //printd(5, "zone: %d secs: %lld.%06d\n", zone, secs, us);
 
     return DateTimeNode::makeAbsoluteLocal(findCreateOffsetZone(-zone), secs, us);
@@ -412,14 +530,7 @@ static QoreValue qpg_data_tinterval(char* data, int type, int len, QorePGConnect
 }
 
 static QoreValue qpg_data_numeric(char* data, int type, int len, QorePGConnection* conn, const QoreEncoding* enc) {
-    // issue #4249: we cannot write directly to the data, as we may be called multiple times on the same data
-    qore_pg_numeric* num = reinterpret_cast<qore_pg_numeric*>(data);
-    size_t size = num->rawSize();
-    qore_pg_numeric* nd = (qore_pg_numeric*)malloc(size);
-    ON_BLOCK_EXIT(free, nd);
-    memcpy(nd, num, size);
-
-    nd->convertToHost();
+    const qore_pg_numeric* nd = reinterpret_cast<const qore_pg_numeric*>(data);
     int nc = conn->getNumeric();
     if (nc == OPT_NUM_OPTIMAL)
         return nd->toOptimal();
@@ -567,111 +678,131 @@ static QoreValue qpg_data_circle(char* data, int type, int len, QorePGConnection
 }
 
 // static initialization
+// sets the decoders for the date/time types, whose binary format depends on the server
+template <bool integer, bool day>
+static void qore_pg_set_datetime_decoders(QorePgsqlDecoderTable& decoder_table) {
+    decoder_table.set(TIMESTAMPOID,   qpg_data_timestamp<integer>);
+    decoder_table.set(TIMESTAMPTZOID, qpg_data_timestamptz<integer>);
+    decoder_table.set(INTERVALOID,    qpg_data_interval<integer, day>);
+    decoder_table.set(TIMEOID,        qpg_data_time<integer>);
+    decoder_table.set(TIMETZOID,      qpg_data_timetz<integer>);
+
+    decoder_table.setArray(QPGT_TIMESTAMPARRAYOID,    TIMESTAMPOID, qpg_data_timestamp<integer>);
+    decoder_table.setArray(QPGT_TIMEARRAYOID,         TIMEOID, qpg_data_time<integer>);
+    decoder_table.setArray(QPGT_TIMESTAMPTZARRAYOID,  TIMESTAMPTZOID, qpg_data_timestamptz<integer>);
+    decoder_table.setArray(QPGT_INTERVALARRAYOID,     INTERVALOID, qpg_data_interval<integer, day>);
+    decoder_table.setArray(QPGT_TIMETZARRAYOID,       TIMETZOID, qpg_data_timetz<integer>);
+}
+
+const QorePgsqlDecoderTable& QorePgsqlStatement::getDecoderTable(bool integer_datetimes, bool interval_day) {
+    return decoder_tables[(integer_datetimes ? 2 : 0) | (interval_day ? 1 : 0)];
+}
+
 void QorePgsqlStatement::static_init() {
-    data_map[BOOLOID]        = qpg_data_bool;
-    data_map[BYTEAOID]       = qpg_data_bytea;
-    data_map[CHAROID]        = qpg_data_char;
-    data_map[BPCHAROID]      = qpg_data_char;
+    // the decoders common to all servers are set in the first table and copied to the others
+    QorePgsqlDecoderTable& decoder_table = decoder_tables[0];
+    decoder_table.set(BOOLOID,        qpg_data_bool);
+    decoder_table.set(BYTEAOID,       qpg_data_bytea);
+    decoder_table.set(CHAROID,        qpg_data_char);
+    decoder_table.set(BPCHAROID,      qpg_data_char);
 
     // treat UNKNOWNOID as string
-    data_map[UNKNOWNOID]     = qpg_data_char;
-
-    data_map[INT8OID]        = qpg_data_int8;
-    data_map[INT4OID]        = qpg_data_int4;
-    data_map[OIDOID]         = qpg_data_int4;
-    data_map[XIDOID]         = qpg_data_int4;
-    data_map[CIDOID]         = qpg_data_int4;
-    //data_map[REGPROCOID]     = qpg_data_int4;
-    data_map[INT2OID]        = qpg_data_int2;
-    data_map[TEXTOID]        = qpg_data_text;
-    data_map[VARCHAROID]     = qpg_data_text;
-    data_map[NAMEOID]        = qpg_data_text;
-    data_map[FLOAT4OID]      = qpg_data_float4;
-    data_map[FLOAT8OID]      = qpg_data_float8;
-    data_map[ABSTIMEOID]     = qpg_data_abstime;
-    data_map[RELTIMEOID]     = qpg_data_reltime;
-
-    data_map[TIMESTAMPOID]   = qpg_data_timestamp;
-    data_map[TIMESTAMPTZOID] = qpg_data_timestamptz;
-    data_map[DATEOID]        = qpg_data_date;
-    data_map[INTERVALOID]    = qpg_data_interval;
-    data_map[TIMEOID]        = qpg_data_time;
-    data_map[TIMETZOID]      = qpg_data_timetz;
-    data_map[TINTERVALOID]   = qpg_data_tinterval;
-    data_map[NUMERICOID]     = qpg_data_numeric;
-    data_map[CASHOID]        = qpg_data_cash;
-    data_map[MACADDROID]     = qpg_data_macaddr;
-    data_map[INETOID]        = qpg_data_inet;
-    data_map[CIDROID]        = qpg_data_inet;
-    data_map[TIDOID]         = qpg_data_tid;
-    data_map[BITOID]         = qpg_data_bit;
-    data_map[VARBITOID]      = qpg_data_bit;
-    data_map[POINTOID]       = qpg_data_point;
-    data_map[LSEGOID]        = qpg_data_lseg;
-    data_map[BOXOID]         = qpg_data_box;
-    data_map[PATHOID]        = qpg_data_path;
-    data_map[POLYGONOID]     = qpg_data_polygon;
-    data_map[CIRCLEOID]      = qpg_data_circle;
-    data_map[XMLOID]         = qpg_data_text;
-    data_map[JSONOID]        = qpg_data_text;
-    data_map[JSONBOID]       = qpg_data_jsonb;
-
-    //data_map[INT2VECTOROID]  = qpg_data_int2vector;
-    //data_map[OIDVECTOROID]   = qpg_data_oidvector;
-
-    //array_data_map[INT2VECTOROID] = std::make_pair(INT2OID, qpg_data_int2);
+    decoder_table.set(UNKNOWNOID,     qpg_data_char);
+
+    decoder_table.set(INT8OID,        qpg_data_int8);
+    decoder_table.set(INT4OID,        qpg_data_int4);
+    decoder_table.set(OIDOID,         qpg_data_int4);
+    decoder_table.set(XIDOID,         qpg_data_int4);
+    decoder_table.set(CIDOID,         qpg_data_int4);
+    //decoder_table.set(REGPROCOID,     qpg_data_int4);
+    decoder_table.set(INT2OID,        qpg_data_int2);
+    decoder_table.set(TEXTOID,        qpg_data_text);
+    decoder_table.set(VARCHAROID,     qpg_data_text);
+    decoder_table.set(NAMEOID,        qpg_data_text);
+    decoder_table.set(FLOAT4OID,      qpg_data_float4);
+    decoder_table.set(FLOAT8OID,      qpg_data_float8);
+    decoder_table.set(ABSTIMEOID,     qpg_data_abstime);
+    decoder_table.set(RELTIMEOID,     qpg_data_reltime);
+
+    decoder_table.set(DATEOID,        qpg_data_date);
+    decoder_table.set(TINTERVALOID,   qpg_data_tinterval);
+    decoder_table.set(NUMERICOID,     qpg_data_numeric);
+    decoder_table.set(CASHOID,        qpg_data_cash);
+    decoder_table.set(MACADDROID,     qpg_data_macaddr);
+    decoder_table.set(INETOID,        qpg_data_inet);
+    decoder_table.set(CIDROID,        qpg_data_inet);
+    decoder_table.set(TIDOID,         qpg_data_tid);
+    decoder_table.set(BITOID,         qpg_data_bit);
+    decoder_table.set(VARBITOID,      qpg_data_bit);
+    decoder_table.set(POINTOID,       qpg_data_point);
+    decoder_table.set(LSEGOID,        qpg_data_lseg);
+    decoder_table.set(BOXOID,         qpg_data_box);
+    decoder_table.set(PATHOID,        qpg_data_path);
+    decoder_table.set(POLYGONOID,     qpg_data_polygon);
+    decoder_table.set(CIRCLEOID,      qpg_data_circle);
+    decoder_table.set(XMLOID,         qpg_data_text);
+    decoder_table.set(JSONOID,        qpg_data_text);
+    decoder_table.set(JSONBOID,       qpg_data_jsonb);
+
+    //decoder_table.set(INT2VECTOROID,  qpg_data_int2vector);
+    //decoder_table.set(OIDVECTOROID,   qpg_data_oidvector);
+
+    //decoder_table.setArray(INT2VECTOROID, INT2OID, qpg_data_int2);
     // NOTE: the casts are necessary with SunPro CC 5.8...
-    array_data_map[QPGT_INT4ARRAYOID]         = std::make_pair(INT4OID, (qore_pg_data_func_t)qpg_data_int4);
-    array_data_map[QPGT_CIRCLEARRAYOID]       = std::make_pair(CIRCLEOID, (qore_pg_data_func_t)qpg_data_circle);
-    array_data_map[QPGT_MONEYARRAYOID]        = std::make_pair(CASHOID, (qore_pg_data_func_t)qpg_data_cash);
-    array_data_map[QPGT_BOOLARRAYOID]         = std::make_pair(BOOLOID, (qore_pg_data_func_t)qpg_data_bool);
-    array_data_map[QPGT_BYTEAARRAYOID]        = std::make_pair(BYTEAOID, (qore_pg_data_func_t)qpg_data_bytea);
-    array_data_map[QPGT_NAMEARRAYOID]         = std::make_pair(NAMEOID, (qore_pg_data_func_t)qpg_data_text);
-    array_data_map[QPGT_INT2ARRAYOID]         = std::make_pair(INT2OID, (qore_pg_data_func_t)qpg_data_int2);
-    //array_data_map[QPGT_INT2VECTORARRAYOID]   = std::make_pair(OID, (qore_pg_data_func_t)qpg_data_);
-    //array_data_map[QPGT_REGPROCARRAYOID]      = std::make_pair(OID, (qore_pg_data_func_t)qpg_data_);
-    array_data_map[QPGT_TEXTARRAYOID]         = std::make_pair(TEXTOID, (qore_pg_data_func_t)qpg_data_text);
-    array_data_map[QPGT_OIDARRAYOID]          = std::make_pair(OIDOID, (qore_pg_data_func_t)qpg_data_int4);
-    array_data_map[QPGT_TIDARRAYOID]          = std::make_pair(TIDOID, (qore_pg_data_func_t)qpg_data_tid);
-    array_data_map[QPGT_XIDARRAYOID]          = std::make_pair(XIDOID, (qore_pg_data_func_t)qpg_data_int4);
-    array_data_map[QPGT_CIDARRAYOID]          = std::make_pair(CIDOID, (qore_pg_data_func_t)qpg_data_int4);
-    //array_data_map[QPGT_OIDVECTORARRAYOID]    = std::make_pair(OID, (qore_pg_data_func_t)qpg_data_);
-    array_data_map[QPGT_BPCHARARRAYOID]       = std::make_pair(BPCHAROID, (qore_pg_data_func_t)qpg_data_char);
-    array_data_map[QPGT_VARCHARARRAYOID]      = std::make_pair(VARCHAROID, (qore_pg_data_func_t)qpg_data_text);
-    array_data_map[QPGT_INT8ARRAYOID]         = std::make_pair(INT8OID, (qore_pg_data_func_t)qpg_data_int8);
-    array_data_map[QPGT_POINTARRAYOID]        = std::make_pair(POINTOID, (qore_pg_data_func_t)qpg_data_point);
-    array_data_map[QPGT_LSEGARRAYOID]         = std::make_pair(LSEGOID, (qore_pg_data_func_t)qpg_data_lseg);
-    array_data_map[QPGT_PATHARRAYOID]         = std::make_pair(PATHOID, (qore_pg_data_func_t)qpg_data_path);
-    array_data_map[QPGT_BOXARRAYOID]          = std::make_pair(BOXOID, (qore_pg_data_func_t)qpg_data_box);
-    array_data_map[QPGT_FLOAT4ARRAYOID]       = std::make_pair(FLOAT4OID, (qore_pg_data_func_t)qpg_data_float4);
-    array_data_map[QPGT_FLOAT8ARRAYOID]       = std::make_pair(FLOAT8OID, (qore_pg_data_func_t)qpg_data_float8);
-    array_data_map[QPGT_ABSTIMEARRAYOID]      = std::make_pair(ABSTIMEOID, (qore_pg_data_func_t)qpg_data_abstime);
-    array_data_map[QPGT_RELTIMEARRAYOID]      = std::make_pair(RELTIMEOID, (qore_pg_data_func_t)qpg_data_reltime);
-    array_data_map[QPGT_TINTERVALARRAYOID]    = std::make_pair(TINTERVALOID, (qore_pg_data_func_t)qpg_data_tinterval);
-    array_data_map[QPGT_POLYGONARRAYOID]      = std::make_pair(POLYGONOID, (qore_pg_data_func_t)qpg_data_polygon);
-    //array_data_map[QPGT_ACLITEMARRAYOID]      = std::make_pair(OID, (qore_pg_data_func_t)qpg_data_);
-    array_data_map[QPGT_MACADDRARRAYOID]      = std::make_pair(MACADDROID, (qore_pg_data_func_t)qpg_data_macaddr);
-    array_data_map[QPGT_INETARRAYOID]         = std::make_pair(INETOID, (qore_pg_data_func_t)qpg_data_inet);
-    array_data_map[QPGT_CIDRARRAYOID]         = std::make_pair(CIDROID, (qore_pg_data_func_t)qpg_data_inet);
-    array_data_map[QPGT_TIMESTAMPARRAYOID]    = std::make_pair(TIMESTAMPOID, (qore_pg_data_func_t)qpg_data_timestamp);
-    array_data_map[QPGT_DATEARRAYOID]         = std::make_pair(DATEOID, (qore_pg_data_func_t)qpg_data_date);
-    array_data_map[QPGT_TIMEARRAYOID]         = std::make_pair(TIMEOID, (qore_pg_data_func_t)qpg_data_time);
-    array_data_map[QPGT_TIMESTAMPTZARRAYOID]  = std::make_pair(TIMESTAMPTZOID, (qore_pg_data_func_t)qpg_data_timestamptz);
-    array_data_map[QPGT_INTERVALARRAYOID]     = std::make_pair(INTERVALOID, (qore_pg_data_func_t)qpg_data_interval);
-    array_data_map[QPGT_NUMERICARRAYOID]      = std::make_pair(NUMERICOID, (qore_pg_data_func_t)qpg_data_numeric);
-    array_data_map[QPGT_TIMETZARRAYOID]       = std::make_pair(TIMETZOID, (qore_pg_data_func_t)qpg_data_timetz);
-    array_data_map[QPGT_BITARRAYOID]          = std::make_pair(BITOID, (qore_pg_data_func_t)qpg_data_bit);
-    array_data_map[QPGT_VARBITARRAYOID]       = std::make_pair(VARBITOID, (qore_pg_data_func_t)qpg_data_bit);
-    //array_data_map[QPGT_REFCURSORARRAYOID]    = std::make_pair(OID, (qore_pg_data_func_t)qpg_data_);
-    //array_data_map[QPGT_REGPROCEDUREARRAYOID] = std::make_pair(OID, (qore_pg_data_func_t)qpg_data_);
-    //array_data_map[QPGT_REGOPERARRAYOID]      = std::make_pair(OID, (qore_pg_data_func_t)qpg_data_);
-    //array_data_map[QPGT_REGOPERATORARRAYOID]  = std::make_pair(OID, (qore_pg_data_func_t)qpg_data_);
-    //array_data_map[QPGT_REGCLASSARRAYOID]     = std::make_pair(OID, (qore_pg_data_func_t)qpg_data_);
-    //array_data_map[QPGT_REGTYPEARRAYOID]      = std::make_pair(OID, (qore_pg_data_func_t)qpg_data_);
-    //array_data_map[QPGT_ANYARRAYOID]          = std::make_pair(OID, (qore_pg_data_func_t)qpg_data_);
-    array_data_map[XMLARRAYOID]              = std::make_pair(XMLOID, (qore_pg_data_func_t)qpg_data_text);
-    array_data_map[JSONARRAYOID]             = std::make_pair(JSONOID, (qore_pg_data_func_t)qpg_data_text);
-    array_data_map[JSONBARRAYOID]            = std::make_pair(JSONBOID, (qore_pg_data_func_t)qpg_data_jsonb);
+    decoder_table.setArray(QPGT_INT4ARRAYOID,         INT4OID, (qore_pg_data_func_t)qpg_data_int4);
+    decoder_table.setArray(QPGT_CIRCLEARRAYOID,       CIRCLEOID, (qore_pg_data_func_t)qpg_data_circle);
+    decoder_table.setArray(QPGT_MONEYARRAYOID,        CASHOID, (qore_pg_data_func_t)qpg_data_cash);
+    decoder_table.setArray(QPGT_BOOLARRAYOID,         BOOLOID, (qore_pg_data_func_t)qpg_data_bool);
+    decoder_table.setArray(QPGT_BYTEAARRAYOID,        BYTEAOID, (qore_pg_data_func_t)qpg_data_bytea);
+    decoder_table.setArray(QPGT_NAMEARRAYOID,         NAMEOID, (qore_pg_data_func_t)qpg_data_text);
+    decoder_table.setArray(QPGT_INT2ARRAYOID,         INT2OID, (qore_pg_data_func_t)qpg_data_int2);
+    //decoder_table.setArray(QPGT_INT2VECTORARRAYOID,   OID, (qore_pg_data_func_t)qpg_data_);
+    //decoder_table.setArray(QPGT_REGPROCARRAYOID,      OID, (qore_pg_data_func_t)qpg_data_);
+    decoder_table.setArray(QPGT_TEXTARRAYOID,         TEXTOID, (qore_pg_data_func_t)qpg_data_text);
+    decoder_table.setArray(QPGT_OIDARRAYOID,          OIDOID, (qore_pg_data_func_t)qpg_data_int4);
+    decoder_table.setArray(QPGT_TIDARRAYOID,          TIDOID, (qore_pg_data_func_t)qpg_data_tid);
+    decoder_table.setArray(QPGT_XIDARRAYOID,          XIDOID, (qore_pg_data_func_t)qpg_data_int4);
+    decoder_table.setArray(QPGT_CIDARRAYOID,          CIDOID, (qore_pg_data_func_t)qpg_data_int4);
+    //decoder_table.setArray(QPGT_OIDVECTORARRAYOID,    OID, (qore_pg_data_func_t)qpg_data_);
+    decoder_table.setArray(QPGT_BPCHARARRAYOID,       BPCHAROID, (qore_pg_data_func_t)qpg_data_char);
+    decoder_table.setArray(QPGT_VARCHARARRAYOID,      VARCHAROID, (qore_pg_data_func_t)qpg_data_text);
+    decoder_table.setArray(QPGT_INT8ARRAYOID,         INT8OID, (qore_pg_data_func_t)qpg_data_int8);
+    decoder_table.setArray(QPGT_POINTARRAYOID,        POINTOID, (qore_pg_data_func_t)qpg_data_point);
+    decoder_table.setArray(QPGT_LSEGARRAYOID,         LSEGOID, (qore_pg_data_func_t)qpg_data_lseg);
+    decoder_table.setArray(QPGT_PATHARRAYOID,         PATHOID, (qore_pg_data_func_t)qpg_data_path);
+    decoder_table.setArray(QPGT_BOXARRAYOID,          BOXOID, (qore_pg_data_func_t)qpg_data_box);
+    decoder_table.setArray(QPGT_FLOAT4ARRAYOID,       FLOAT4OID, (qore_pg_data_func_t)qpg_data_float4);
+    decoder_table.setArray(QPGT_FLOAT8ARRAYOID,       FLOAT8OID, (qore_pg_data_func_t)qpg_data_float8);
+    decoder_table.setArray(QPGT_ABSTIMEARRAYOID,      ABSTIMEOID, (qore_pg_data_func_t)qpg_data_abstime);
+    decoder_table.setArray(QPGT_RELTIMEARRAYOID,      RELTIMEOID, (qore_pg_data_func_t)qpg_data_reltime);
+    decoder_table.setArray(QPGT_TINTERVALARRAYOID,    TINTERVALOID, (qore_pg_data_func_t)qpg_data_tinterval);
+    decoder_table.setArray(QPGT_POLYGONARRAYOID,      POLYGONOID, (qore_pg_data_func_t)qpg_data_polygon);
+    //decoder_table.setArray(QPGT_ACLITEMARRAYOID,      OID, (qore_pg_data_func_t)qpg_data_);
+    decoder_table.setArray(QPGT_MACADDRARRAYOID,      MACADDROID, (qore_pg_data_func_t)qpg_data_macaddr);
+    decoder_table.setArray(QPGT_INETARRAYOID,         INETOID, (qore_pg_data_func_t)qpg_data_inet);
+    decoder_table.setArray(QPGT_CIDRARRAYOID,         CIDROID, (qore_pg_data_func_t)qpg_data_inet);
+    decoder_table.setArray(QPGT_DATEARRAYOID,         DATEOID, (qore_pg_data_func_t)qpg_data_date);
+    decoder_table.setArray(QPGT_NUMERICARRAYOID,      NUMERICOID, (qore_pg_data_func_t)qpg_data_numeric);
+    decoder_table.setArray(QPGT_BITARRAYOID,          BITOID, (qore_pg_data_func_t)qpg_data_bit);
+    decoder_table.setArray(QPGT_VARBITARRAYOID,       VARBITOID, (qore_pg_data_func_t)qpg_data_bit);
+    //decoder_table.setArray(QPGT_REFCURSORARRAYOID,    OID, (qore_pg_data_func_t)qpg_data_);
+    //decoder_table.setArray(QPGT_REGPROCEDUREARRAYOID, OID, (qore_pg_data_func_t)qpg_data_);
+    //decoder_table.setArray(QPGT_REGOPERARRAYOID,      OID, (qore_pg_data_func_t)qpg_data_);
+    //decoder_table.setArray(QPGT_REGOPERATORARRAYOID,  OID, (qore_pg_data_func_t)qpg_data_);
+    //decoder_table.setArray(QPGT_REGCLASSARRAYOID,     OID, (qore_pg_data_func_t)qpg_data_);
+    //decoder_table.setArray(QPGT_REGTYPEARRAYOID,      OID, (qore_pg_data_func_t)qpg_data_);
+    //decoder_table.setArray(QPGT_ANYARRAYOID,          OID, (qore_pg_data_func_t)qpg_data_);
+    decoder_table.setArray(XMLARRAYOID,              XMLOID, (qore_pg_data_func_t)qpg_data_text);
+    decoder_table.setArray(JSONARRAYOID,             JSONOID, (qore_pg_data_func_t)qpg_data_text);
+    decoder_table.setArray(JSONBARRAYOID,            JSONBOID, (qore_pg_data_func_t)qpg_data_jsonb);
+
+    // all common decoders must be set before the table is copied
+    for (int i = 1; i < 4; ++i)
+        decoder_tables[i] = decoder_table;
+    qore_pg_set_datetime_decoders<false, false>(decoder_tables[0]);
+    qore_pg_set_datetime_decoders<false, true>(decoder_tables[1]);
+    qore_pg_set_datetime_decoders<true, false>(decoder_tables[2]);
+    qore_pg_set_datetime_decoders<true, true>(decoder_tables[3]);
 
     array_type_map[INT4OID]                      = QPGT_INT4ARRAYOID;
     array_type_map[CIRCLEOID]                    = QPGT_CIRCLEARRAYOID;
@@ -734,6 +865,9 @@ void QorePgsqlStatement::reset() {
         PQclear(res);
         res = 0;
     }
+    // the decoders depend on the server, which can change when the connection is reset
+    columns.clear();
+    columns_res = nullptr;
 
     if (allocated) {
         parambuf_list_t::iterator i = parambuf_list.begin();
@@ -805,36 +939,90 @@ QoreListNode* QorePgsqlStatement::getArray(int type, qore_pg_data_func_t func, c
     return l;
 }
 
+// returns the value type for lists of the given column type with the "typed-columns" option
+static const QoreTypeInfo* qore_pg_list_type(Oid type) {
+    switch (type) {
+        case INT2OID:
+        case INT4OID:
+        case INT8OID:
+            return bigIntOrNothingTypeInfo;
+        case FLOAT4OID:
+        case FLOAT8OID:
+            return floatOrNothingTypeInfo;
+        case BOOLOID:
+            return boolOrNothingTypeInfo;
+        case TIMESTAMPOID:
+        case TIMESTAMPTZOID:
+        case DATEOID:
+            return dateOrNothingTypeInfo;
+    }
+    return nullptr;
+}
+
+const qore_pg_column_plan_t& QorePgsqlStatement::getColumns() {
+    assert(res);
+    if (res == columns_res)
+        return columns;
+
+    int num_columns = PQnfields(res);
+    bool same = (int)columns.size() == num_columns;
+    for (int i = 0; same && i < num_columns; ++i)
+        same = columns[i].type == PQftype(res, i) && columns[i].fname == PQfname(res, i);
+
+    if (!same) {
+        columns.clear();
+        columns.reserve(num_columns);
+        std::unordered_set<std::string> keys;
+        for (int i = 0; i < num_columns; ++i) {
+            const char* fname = PQfname(res, i);
+            Oid type = PQftype(res, i);
+            std::string name = fname;
+            if (!keys.insert(name).second) {
+                // find a unique column name
+                unsigned num = 1;
+                while (true) {
+                    QoreStringMaker tmp("%s_%d", fname, num);
+                    if (keys.insert(tmp.c_str()).second) {
+                        name = tmp.c_str();
+                        break;
+                    }
+                    ++num;
+                }
+            }
+            columns.push_back({type, conn->getDecoders().find(type), fname, name, qore_pg_list_type(type)});
+        }
+    }
+    columns_res = res;
+    return columns;
+}
+
 // converts from PostgreSQL data types to Qore data
-QoreValue QorePgsqlStatement::getValue(int row, int col, ExceptionSink *xsink) {
-    void* data = PQgetvalue(res, row, col);
-    int type = PQftype(res, col);
-    //int mod = PQfmod(res, col);
-    int len = PQgetlength(res, row, col);
-
-    //printd(5, "QorePgsqlStatement::getValue(row: %d, col: %d) type: %d this: %p len: %d\n", row, col, type, this, len);
-    //do_output((char*)data, len);
+QoreValue QorePgsqlStatement::getValue(int row, int col, const qore_pg_column& c, ExceptionSink *xsink) {
     assert(row >= 0);
-
     if (PQgetisnull(res, row, col))
         return null();
 
-    qore_pg_data_map_t::const_iterator i = data_map.find(type);
-    if (i != data_map.end())
-        return i->second((char*)data, type, len, conn, enc);
+    //printd(5, "QorePgsqlStatement::getValue(row: %d, col: %d) type: %d this: %p\n", row, col, c.type, this);
+    return decodeValue(PQgetvalue(res, row, col), c, PQgetlength(res, row, col), xsink);
+}
 
-    // otherwise, see if it's an array
-    qore_pg_array_data_map_t::const_iterator ai = array_data_map.find(type);
-    if (ai == array_data_map.end()) {
-        xsink->raiseException("DBI:PGSQL:TYPE-ERROR", "don't know how to handle type ID: %d", type);
+QoreValue QorePgsqlStatement::decodeValue(char* data, const qore_pg_column& c, int len, ExceptionSink* xsink) {
+    const qore_pg_decoder* d = c.decoder;
+    if (!d) {
+        xsink->raiseException("DBI:PGSQL:TYPE-ERROR", "don't know how to handle type ID: %d", (int)c.type);
         return QoreValue();
     }
+    if (d->func)
+        return d->func((char*)data, c.type, len, conn, enc);
 
-    //printd(5, "QorePgsqlStatement::getValue(row: %d, col: %d) ARRAY type: %d this: %p len: %d\n", row, col, type, this, len);
+    //printd(5, "QorePgsqlStatement::decodeValue() ARRAY type: %d this: %p len: %d\n", c.type, this, len);
     qore_pg_array_header *ah = (qore_pg_array_header *)data;
     int ndim = ntohl(ah->ndim);
     //int oid  = ntohl(ah->oid);
     //printd(5, "array dimensions %d, oid: %d\n", ndim, oid);
+    // empty arrays are sent without any dimensions
+    if (!ndim)
+        return new QoreListNode;
     int dim[ndim];
     //int lBound[ndim];
     for (int i = 0; i < ndim; ++i) {
@@ -844,31 +1032,17 @@ QoreValue QorePgsqlStatement::getValue(int row, int col, ExceptionSink *xsink) {
     }
 
     char* array_data = ((char*)data) + 12 + 8 * ndim;
-    return getArray(ai->second.first, ai->second.second, array_data, 0, ndim, dim);
+    return getArray(d->elem_type, d->elem_func, array_data, 0, ndim, dim);
 }
 
-void QorePgsqlStatement::setupColumns(QoreHashNode& h, strvec_t& cvec, int num_columns) {
-    for (int i = 0; i < num_columns; ++i) {
-        const char* name = PQfname(res, i);
-
-        HashAssignmentHelper hah(h, name);
-        if (!hah.get().isNothing()) {
-            // find a unique column name
-            unsigned num = 1;
-            while (true) {
-                QoreStringMaker tmp("%s_%d", name, num);
-                hah.reassign(tmp.c_str());
-                if (!hah.get().isNothing()) {
-                    ++num;
-                    continue;
-                }
-                cvec.push_back(tmp.c_str());
-                break;
-            }
-        } else
-            cvec.push_back(name);
-
-        hah.assign(new QoreListNode, 0);
+void QorePgsqlStatement::setupColumns(QoreHashNode& h, std::vector<QoreListNode*>& cvec) {
+    const qore_pg_column_plan_t& cols = getColumns();
+    bool typed = conn->getTypedColumns();
+    cvec.reserve(cols.size());
+    for (auto& i : cols) {
+        QoreListNode* l = typed && i.list_type ? new QoreListNode(i.list_type) : new QoreListNode;
+        h.setKeyValue(i.name.c_str(), l, nullptr);
+        cvec.push_back(l);
     }
 }
 
@@ -876,37 +1050,127 @@ QoreHashNode* QorePgsqlStatement::getOutputHash(ExceptionSink* xsink, bool cols,
     assert(res);
     ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
 
-    int num_columns = PQnfields(res);
+    //printd(5, "QorePgsqlStatement::getOutputHash() num_columns: %d num_rows: %d\n", PQnfields(res), PQntuples(res));
 
-    //printd(5, "QorePgsqlStatement::getOutputHash() num_columns: %d num_rows: %d\n", num_columns, PQntuples(res));
+    std::vector<QoreListNode*> cvec;
+    if (cols)
+        setupColumns(**h, cvec);
 
     int i = start ? *start : 0;
-    maxrows += i;
+    if (appendOutputHash(**h, cvec, i, maxrows, xsink))
+        return nullptr;
 
+    if (start)
+        *start = i;
+    return h.release();
+}
+
+int QorePgsqlStatement::appendOutputHash(QoreHashNode& h, std::vector<QoreListNode*>& cvec, int& i, int maxrows,
+        ExceptionSink* xsink) {
     int nt = PQntuples(res);
-    int max = maxrows < 0 ? nt : (maxrows > nt ? nt : maxrows);
+    int max = (maxrows < 0 || (maxrows + i) > nt) ? nt : maxrows + i;
+    if (i >= max)
+        return 0;
 
-    strvec_t cvec;
+    const qore_pg_column_plan_t& cols = getColumns();
+    if (cvec.empty())
+        setupColumns(h, cvec);
 
-    if (cols || (i < max)) {
-        // assign unique column names
-        cvec.reserve(num_columns);
-        setupColumns(**h, cvec, num_columns);
+    int num_columns = (int)cols.size();
+    if (conn->getTypedColumns()) {
+        // values are appended one column at a time
+        for (int j = 0; j < num_columns; ++j) {
+            if (appendColumn(*cvec[j], j, cols[j], i, max, xsink))
+                return -1;
+        }
+        i = max;
+        return 0;
     }
 
     for (; i < max; ++i) {
         for (int j = 0; j < num_columns; ++j) {
-            ValueHolder n(getValue(i, j, xsink), xsink);
+            ValueHolder n(getValue(i, j, cols[j], xsink), xsink);
             if (!n || *xsink)
-                return nullptr;
+                return -1;
 
-            QoreListNode* l = h->getKeyValue(cvec[j].c_str()).get<QoreListNode>();
-            l->push(n.release(), xsink);
+            cvec[j]->push(n.release(), xsink);
         }
     }
-    if (start)
-        *start = i;
-    return h.release();
+    return 0;
+}
+
+// assigns the non-NULL values of a column to the preallocated list entries with the given function; NULL values are
+// left as NOTHING in typed lists
+template <typename F>
+static void qore_pg_fill_column(PGresult* res, QoreListNode& l, size_t base, int col, int start, int end,
+        bool typed, F f) {
+    for (int row = start; row < end; ++row) {
+        QoreValue& v = l.getEntryReference(base + row - start);
+        if (PQgetisnull(res, row, col)) {
+            if (!typed)
+                v = null();
+            continue;
+        }
+        v = f(PQgetvalue(res, row, col));
+    }
+}
+
+int QorePgsqlStatement::appendColumn(QoreListNode& l, int col, const qore_pg_column& c, int start, int end,
+        ExceptionSink* xsink) {
+    if (start >= end)
+        return 0;
+
+    // the list is extended once for all values
+    size_t base = l.size();
+    l.getEntryReference(base + (end - start) - 1);
+
+    bool typed = c.list_type;
+    switch (c.type) {
+        case INT2OID:
+            qore_pg_fill_column(res, l, base, col, start, end, typed, [] (char* data) -> QoreValue {
+                return ntohs(*((uint16_t *)data));
+            });
+            return 0;
+        case INT4OID:
+            qore_pg_fill_column(res, l, base, col, start, end, typed, [] (char* data) -> QoreValue {
+                return ntohl(*((uint32_t *)data));
+            });
+            return 0;
+        case INT8OID:
+            qore_pg_fill_column(res, l, base, col, start, end, typed, [] (char* data) -> QoreValue {
+                return MSBi8(*((uint64_t *)data));
+            });
+            return 0;
+        case FLOAT4OID:
+            qore_pg_fill_column(res, l, base, col, start, end, typed, [] (char* data) -> QoreValue {
+                return (double)MSBf4(*((float *)data));
+            });
+            return 0;
+        case FLOAT8OID:
+            qore_pg_fill_column(res, l, base, col, start, end, typed, [] (char* data) -> QoreValue {
+                return MSBf8(*((double *)data));
+            });
+            return 0;
+        case BOOLOID:
+            qore_pg_fill_column(res, l, base, col, start, end, typed, [] (char* data) -> QoreValue {
+                return *((bool*)data);
+            });
+            return 0;
+    }
+
+    // other types are decoded with the column's decoder
+    for (int row = start; row < end; ++row) {
+        QoreValue& v = l.getEntryReference(base + row - start);
+        if (PQgetisnull(res, row, col)) {
+            if (!typed)
+                v = null();
+            continue;
+        }
+        v = decodeValue(PQgetvalue(res, row, col), c, PQgetlength(res, row, col), xsink);
+        if (*xsink)
+            return -1;
+    }
+    return 0;
 }
 
 QoreHashNode* QorePgsqlStatement::getSingleRow(ExceptionSink* xsink, int row) {
@@ -924,30 +1188,13 @@ QoreHashNode* QorePgsqlStatement::getSingleRow(ExceptionSink* xsink, int row) {
 QoreHashNode* QorePgsqlStatement::getSingleRowIntern(ExceptionSink* xsink, int row) {
     ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
 
-    int num_columns = PQnfields(res);
-
-    for (int j = 0; j < num_columns; ++j) {
-        ValueHolder n(getValue(row, j, xsink), xsink);
+    const qore_pg_column_plan_t& cols = getColumns();
+    for (int j = 0, e = (int)cols.size(); j < e; ++j) {
+        ValueHolder n(getValue(row, j, cols[j], xsink), xsink);
         if (!n || *xsink)
             return nullptr;
 
-        const char* name = PQfname(res, j);
-        HashAssignmentHelper hah(**h, name);
-        if (!hah.get().isNothing()) {
-            // find a unique column name
-            unsigned num = 1;
-            while (true) {
-                QoreStringMaker tmp("%s_%d", name, num);
-                hah.reassign(tmp.c_str());
-                if (!hah.get().isNothing()) {
-                    ++num;
-                    continue;
-                }
-                break;
-            }
-        }
-
-        hah.assign(n.release(), xsink);
+        h->setKeyValue(cols[j].name.c_str(), n.release(), xsink);
     }
     return h.release();
 }
@@ -955,47 +1202,38 @@ QoreHashNode* QorePgsqlStatement::getSingleRowIntern(ExceptionSink* xsink, int r
 QoreListNode* QorePgsqlStatement::getOutputList(ExceptionSink *xsink, int* start, int maxrows) {
     ReferenceHolder<QoreListNode> l(new QoreListNode(autoTypeInfo), xsink);
 
-    int num_columns = PQnfields(res);
-
-    printd(5, "QorePgsqlStatement::getOutputList() num_columns: %d num_rows: %d\n", num_columns, PQntuples(res));
+    printd(5, "QorePgsqlStatement::getOutputList() num_columns: %d num_rows: %d\n", PQnfields(res), PQntuples(res));
 
     int i = start ? *start : 0;
-    maxrows += i;
+    if (appendOutputList(**l, i, maxrows, xsink))
+        return nullptr;
+
+    if (start)
+        *start = i;
+
+    return l.release();
+}
 
+int QorePgsqlStatement::appendOutputList(QoreListNode& l, int& i, int maxrows, ExceptionSink* xsink) {
     int nt = PQntuples(res);
-    int max = maxrows < 0 ? nt : (maxrows > nt ? nt : maxrows);
+    int max = (maxrows < 0 || (maxrows + i) > nt) ? nt : maxrows + i;
+    if (i >= max)
+        return 0;
 
+    const qore_pg_column_plan_t& cols = getColumns();
+    int num_columns = (int)cols.size();
     for (; i < max; ++i) {
         ReferenceHolder<QoreHashNode> h(new QoreHashNode, xsink);
         for (int j = 0; j < num_columns; ++j) {
-            ValueHolder n(getValue(i, j, xsink), xsink);
+            ValueHolder n(getValue(i, j, cols[j], xsink), xsink);
             if (!n || *xsink)
-                return nullptr;
-
-            const char* name = PQfname(res, j);
-            HashAssignmentHelper hah(**h, name);
-            if (!hah.get().isNothing()) {
-                // find a unique column name
-                unsigned num = 1;
-                while (true) {
-                    QoreStringMaker tmp("%s_%d", name, num);
-                    hah.reassign(tmp.c_str());
-                    if (!hah.get().isNothing()) {
-                        ++num;
-                        continue;
-                    }
-                    break;
-                }
-            }
+                return -1;
 
-            hah.assign(n.release(), xsink);
+            h->setKeyValue(cols[j].name.c_str(), n.release(), xsink);
         }
-        l->push(h.release(), xsink);
+        l.push(h.release(), xsink);
     }
-    if (start)
-        *start = i;
-
-    return l.release();
+    return 0;
 }
 
 static int check_hash_type(const QoreHashNode* h, ExceptionSink *xsink) {
@@ -1077,10 +1315,17 @@ int QorePgsqlStatement::add(QoreValue v, ExceptionSink *xsink) {
     }
 
     if (ntype == NT_NUMBER) {
-        paramTypes[nParams]   = NUMERICOID;
         // create output numeric buffer structure
-        pb->num = new qore_pg_numeric_out(v.get<const QoreNumberNode>());
-        paramValues[nParams]  = (char*)pb->num;
+        std::unique_ptr<qore_pg_numeric_out> num(new qore_pg_numeric_out);
+        if (num->set(v.get<const QoreNumberNode>(), xsink)) {
+            paramTypes[nParams] = 0;
+            paramValues[nParams] = 0;
+            ++nParams;
+            return -1;
+        }
+        paramTypes[nParams]   = NUMERICOID;
+        pb->num = num.release();
+        paramValues[nParams]  = (char*)pb->num->getData();
         paramLengths[nParams] = pb->num->getSize();
 
         ++nParams;
@@ -1576,112 +1821,233 @@ int QorePGBindArray::process_list(const QoreListNode* l, int current, const Qore
     return 0;
 }
 
-#define QPDC_LINE 1
-#define QPDC_BLOCK 2
+qore_pg_sql_template_t QorePgsqlSqlTemplateCache::get(const std::string& key) {
+    AutoLocker al(m);
+    lru_map_t::iterator i = lru_map.find(key);
+    if (i == lru_map.end())
+        return qore_pg_sql_template_t();
 
-int QorePgsqlStatement::parse(QoreString* str, const QoreListNode* args, ExceptionSink* xsink) {
-    char quote = 0;
-    const char* p = str->c_str();
-    QoreString tmp;
-    int index = 0;
-    int comment = 0;
+    // move the entry to the front of the list
+    lru.splice(lru.begin(), lru, i->second);
+    return i->second->second;
+}
 
-    while (*p) {
-        if (!quote) {
-            if (!comment) {
-                if ((*p) == '-' && (*(p+1)) == '-') {
-                    comment = QPDC_LINE;
-                    p += 2;
-                    continue;
-                }
+void QorePgsqlSqlTemplateCache::add(const std::string& key, const qore_pg_sql_template_t& tmpl) {
+    AutoLocker al(m);
+    // another thread may have added the same SQL in the meantime
+    if (lru_map.find(key) != lru_map.end())
+        return;
 
-                if ((*p) == '/' && (*(p+1)) == '*') {
-                    comment = QPDC_BLOCK;
-                    p += 2;
-                    continue;
-                }
-            } else {
-                if (comment == QPDC_LINE) {
-                    if ((*p) == '\n' || ((*p) == '\r'))
-                        comment = 0;
-                    ++p;
-                    continue;
-                }
+    if (lru.size() >= QORE_PG_SQL_TEMPLATE_CACHE_SIZE) {
+        lru_map.erase(lru.back().first);
+        lru.pop_back();
+    }
+
+    lru.emplace_front(key, tmpl);
+    lru_map[key] = lru.begin();
+}
+
+qore_pg_sql_template_t QorePgsqlStatement::getTemplate(const QoreString& str, ExceptionSink* xsink) {
+    if (str.size() > QORE_PG_SQL_TEMPLATE_MAX_SQL)
+        return compileTemplate(str, xsink);
+
+    std::string key(str.c_str(), str.size());
+    qore_pg_sql_template_t tmpl = template_cache.get(key);
+    if (!tmpl) {
+        tmpl = compileTemplate(str, xsink);
+        if (tmpl)
+            template_cache.add(key, tmpl);
+    }
+    return tmpl;
+}
+
+#define QPDC_LINE 1
+#define QPDC_BLOCK 2
+
+static bool qore_pg_is_ident_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '$';
+}
+
+// returns the length of the dollar-quote tag starting at p ("$$" or "$tag$") or 0 if there is none
+static size_t qore_pg_dollar_tag_len(const char* p, const char* end) {
+    assert(*p == '$');
+    const char* t = p + 1;
+    if (t < end && (isalpha((unsigned char)*t) || *t == '_')) {
+        ++t;
+        while (t < end && (isalnum((unsigned char)*t) || *t == '_'))
+            ++t;
+    }
+    return (t < end && *t == '$') ? t - p + 1 : 0;
+}
+
+qore_pg_sql_template_t QorePgsqlStatement::compileTemplate(const QoreString& sql, ExceptionSink* xsink) {
+    std::shared_ptr<QorePgsqlSqlTemplate> rv = std::make_shared<QorePgsqlSqlTemplate>();
+    std::string& out = rv->sql;
+    // leave room for a few "$<n>" placeholders that are longer than "%v"
+    out.reserve(sql.size() + 32);
+
+    const char* p = sql.c_str();
+    const char* end = p + sql.size();
+    char quote = 0;
+    // true if the current quoted string is an E'' string with backslash escapes
+    bool escape_str = false;
+    int comment = 0;
+    int nvalues = 0;
 
-                assert(comment == QPDC_BLOCK);
-                if ((*p) == '*' && (*(p+1)) == '/') {
+    while (p < end) {
+        if (comment) {
+            if (comment == QPDC_LINE) {
+                if ((*p) == '\n' || ((*p) == '\r'))
                     comment = 0;
-                    p += 2;
-                    continue;
-                }
+                out += *p++;
+                continue;
+            }
 
-                ++p;
+            assert(comment == QPDC_BLOCK);
+            if ((*p) == '*' && (*(p+1)) == '/') {
+                comment = 0;
+                out.append(p, 2);
+                p += 2;
                 continue;
             }
 
-            if ((*p) == '%' && (p == str->c_str() || !isalnum(*(p-1)))) { // found value marker
-                int offset = p - str->c_str();
+            out += *p++;
+            continue;
+        }
 
-                p++;
-                QoreValue v = args ? args->retrieveEntry(index++) : QoreValue();
-                if ((*p) == 'd') {
-                    DBI_concat_numeric(&tmp, v);
-                    str->replace(offset, 2, tmp.c_str());
-                    p = str->c_str() + offset + tmp.strlen();
-                    tmp.clear();
-                    continue;
-                }
-                if ((*p) == 's') {
-                    if (DBI_concat_string(&tmp, v, xsink))
-                        return -1;
-                    str->replace(offset, 2, tmp.c_str());
-                    p = str->c_str() + offset + tmp.strlen();
-                    tmp.clear();
-                    continue;
-                }
-                if ((*p) != 'v') {
-                    xsink->raiseException("DBI-EXEC-PARSE-EXCEPTION", "invalid value specification (expecting '%%v' or '%%d', got %%%c)", *p);
-                    return -1;
-                }
-                p++;
-                if (isalpha(*p)) {
-                    xsink->raiseException("DBI-EXEC-PARSE-EXCEPTION", "invalid value specification (expecting '%%v' or '%%d', got %%v%c*)", *p);
-                    return -1;
-                }
+        if (quote) {
+            if (escape_str && (*p) == '\\' && (p + 1) < end) {
+                out.append(p, 2);
+                p += 2;
+                continue;
+            }
+            if ((*p) == quote)
+                quote = 0;
+            out += *p++;
+            continue;
+        }
 
-                // replace value marker with "$<num>"
-                // find byte offset in case string buffer is reallocated with replace()
-                tmp.sprintf("$%d", nParams + 1);
-                str->replace(offset, 2, tmp.c_str());
-                p = str->c_str() + offset + tmp.strlen();
-                tmp.clear();
-                if (add(v, xsink))
-                    return -1;
+        if ((*p) == '-' && (*(p+1)) == '-') {
+            comment = QPDC_LINE;
+            out.append(p, 2);
+            p += 2;
+            continue;
+        }
+
+        if ((*p) == '/' && (*(p+1)) == '*') {
+            comment = QPDC_BLOCK;
+            out.append(p, 2);
+            p += 2;
+            continue;
+        }
+
+        if ((*p) == '%' && (out.empty() || !isalnum((unsigned char)out.back()))) { // found value marker
+            ++p;
+            if ((*p) == 'd' || (*p) == 's') {
+                // the literal value is inserted here when binding
+                rv->placeholders.push_back({*p, out.size()});
+                rv->has_literals = true;
+                ++p;
                 continue;
             }
+            if ((*p) != 'v') {
+                xsink->raiseException("DBI-EXEC-PARSE-EXCEPTION", "invalid value specification (expecting '%%v' or '%%d', got %%%c)", *p);
+                return qore_pg_sql_template_t();
+            }
+            ++p;
+            if (isalpha((unsigned char)*p)) {
+                xsink->raiseException("DBI-EXEC-PARSE-EXCEPTION", "invalid value specification (expecting '%%v' or '%%d', got %%v%c*)", *p);
+                return qore_pg_sql_template_t();
+            }
 
-            // allow escaping of '%' characters
-            if ((*p) == '\\' && (*(p+1) == ':' || *(p+1) == '%')) {
-                str->splice(p - str->c_str(), 1, xsink);
-                p += 2;
+            // replace value marker with "$<num>"
+            out += '$';
+            out += std::to_string(++nvalues);
+            rv->placeholders.push_back({'v', 0});
+            continue;
+        }
+
+        // allow escaping of '%' characters
+        if ((*p) == '\\' && (*(p+1) == ':' || *(p+1) == '%')) {
+            out += *(p+1);
+            p += 2;
+            continue;
+        }
+
+        if ((*p) == '\'' || (*p) == '"') {
+            // a doubled quote reopens the string that was just closed, so it keeps the previous escape mode
+            if (out.empty() || out.back() != *p) {
+                // E'' strings allow backslash escapes including \'
+                escape_str = (*p) == '\'' && !out.empty() && (out.back() == 'E' || out.back() == 'e')
+                    && (out.size() == 1 || !qore_pg_is_ident_char(out[out.size() - 2]));
+            }
+            quote = *p;
+            out += *p++;
+            continue;
+        }
+
+        // dollar-quoted strings are copied verbatim up to the closing tag
+        if ((*p) == '$' && (out.empty() || !qore_pg_is_ident_char(out.back()))) {
+            size_t len = qore_pg_dollar_tag_len(p, end);
+            if (len) {
+                const char* close = strstr(p + len, std::string(p, len).c_str());
+                const char* e = close ? close + len : end;
+                out.append(p, e - p);
+                p = e;
                 continue;
             }
         }
 
-        if (((*p) == '\'') || ((*p) == '\"')) {
-            if (!quote)
-                quote = *p;
-            else if (quote == (*p))
-                quote = 0;
-            p++;
+        out += *p++;
+    }
+
+    return rv;
+}
+
+int QorePgsqlStatement::bindTemplate(const QorePgsqlSqlTemplate& tmpl, const QoreListNode* args, QoreString& str,
+        ExceptionSink* xsink) {
+    // the SQL text only has to be built if literal values are substituted
+    if (tmpl.has_literals)
+        str.clear();
+
+    size_t last = 0;
+    int index = 0;
+    for (auto& i : tmpl.placeholders) {
+        QoreValue v = args ? args->retrieveEntry(index++) : QoreValue();
+        if (i.kind == 'v') {
+            if (add(v, xsink))
+                return -1;
             continue;
         }
 
-        p++;
+        str.concat(tmpl.sql.c_str() + last, i.offset - last);
+        last = i.offset;
+        if (i.kind == 'd')
+            DBI_concat_numeric(&str, v);
+        else {
+            assert(i.kind == 's');
+            if (DBI_concat_string(&str, v, xsink))
+                return -1;
+        }
     }
+
+    if (tmpl.has_literals)
+        str.concat(tmpl.sql.c_str() + last, tmpl.sql.size() - last);
     return 0;
 }
 
+int QorePgsqlStatement::parse(QoreString* str, const QoreListNode* args, ExceptionSink* xsink) {
+    qore_pg_sql_template_t tmpl = getTemplate(*str, xsink);
+    if (!tmpl)
+        return -1;
+
+    if (!tmpl->has_literals) {
+        str->clear();
+        str->concat(tmpl->sql.c_str(), tmpl->sql.size());
+    }
+    return bindTemplate(*tmpl, args, *str, xsink);
+}
+
 // hackish way to determine if a pre release 8 server is using int8 or float8 types for datetime values
 bool QorePgsqlStatement::checkIntegerDateTimes(ExceptionSink *xsink) {
     PGresult* tres = PQexecParams(conn->get(), "select '00:00'::time as \"a\"", 0, NULL, NULL, NULL, NULL, 1);
@@ -1722,23 +2088,157 @@ bool QorePgsqlStatement::checkIntegerDateTimes(ExceptionSink *xsink) {
     return val == 0;
 }
 
-int QorePgsqlStatement::execIntern(const char* sql, ExceptionSink* xsink) {
+PGresult* QorePgsqlStatement::execCmd(const char* sql, bool stream) {
+    int64 timeout_ms = use_timeout ? conn->getQueryTimeout() : 0;
+    if (conn->isBeginPending()) {
+        if (!stream && !timeout_ms)
+            return execCmdWithBegin(sql);
+        // streamed results and results read with a timeout are not read in pipeline mode, so a deferred BEGIN is
+        // sent separately
+        PGresult* bres = conn->execBegin();
+        if (bres)
+            return bres;
+    }
+    if (stream) {
+        PGresult* sres = conn->setStreamSavepoint();
+        if (sres)
+            return sres;
+    }
+    if (!pstmt) {
+        if (!stream && !timeout_ms)
+            return PQexecParams(conn->get(), sql, nParams, paramTypes, paramValues, paramLengths, paramFormats, 1);
+        return getResult(PQsendQueryParams(conn->get(), sql, nParams, paramTypes, paramValues, paramLengths,
+            paramFormats, 1), stream, timeout_ms);
+    }
+
+    PGresult* pres = prepareCmd(sql);
+    if (pres)
+        return pres;
+
+    if (!stream && !timeout_ms)
+        return PQexecPrepared(conn->get(), pstmt->name.c_str(), nParams, paramValues, paramLengths, paramFormats, 1);
+    return getResult(PQsendQueryPrepared(conn->get(), pstmt->name.c_str(), nParams, paramValues, paramLengths,
+        paramFormats, 1), stream, timeout_ms);
+}
+
+PGresult* QorePgsqlStatement::prepareCmd(const char* sql) {
+    // prepare the statement on the server if it has not been prepared on the current connection or if the
+    // parameter types have changed since it was prepared
+    if (pstmt->gen != conn->getGeneration() || !pstmt->matches(nParams, paramTypes)) {
+        if (pstmt->gen == conn->getGeneration()) {
+            // the statement must be prepared under a new name, as deallocating the old one may be deferred
+            conn->deallocate(*pstmt);
+            pstmt->name = conn->getStatementName();
+        }
+        PGresult* pres = PQprepare(conn->get(), pstmt->name.c_str(), sql, nParams, paramTypes);
+        if (PQresultStatus(pres) != PGRES_COMMAND_OK)
+            return pres;
+        PQclear(pres);
+        pstmt->types.assign(paramTypes, paramTypes + nParams);
+        pstmt->gen = conn->getGeneration();
+        printd(5, "QorePgsqlStatement::prepareCmd() this: %p prepared '%s' nParams: %d sql: %s\n", this,
+            pstmt->name.c_str(), nParams, sql);
+    }
+    return nullptr;
+}
+
+PGresult* QorePgsqlStatement::execCmdWithBegin(const char* sql) {
+    PGconn* pc = conn->get();
+    // statements cannot be prepared synchronously in pipeline mode
+    if (pstmt) {
+        PGresult* pres = prepareCmd(sql);
+        if (pres)
+            return pres;
+    }
+
+    {
+        ExceptionSink xsink;
+        if (conn->enterPipeline(&xsink)) {
+            xsink.clear();
+            return PQmakeEmptyPGresult(pc, PGRES_FATAL_ERROR);
+        }
+    }
+    conn->takeBeginPending();
+
+    bool sent = !conn->sendPipelineCmd("begin")
+        && (pstmt
+            ? PQsendQueryPrepared(pc, pstmt->name.c_str(), nParams, paramValues, paramLengths, paramFormats, 1)
+            : PQsendQueryParams(pc, sql, nParams, paramTypes, paramValues, paramLengths, paramFormats, 1))
+        && !conn->flushPipeline();
+    bool synced = conn->syncPipeline();
+
+    PGresult* rv = nullptr;
+    if (sent && synced) {
+        rv = conn->getPipelineResult();
+        // the command is skipped by the server if BEGIN fails
+        if (rv && PQresultStatus(rv) == PGRES_COMMAND_OK) {
+            PQclear(rv);
+            rv = conn->getPipelineResult();
+        }
+    }
+    // if pipeline mode cannot be exited, an error is returned, and the connection is reset by the caller
+    if (conn->exitPipeline(synced) && rv) {
+        PQclear(rv);
+        rv = nullptr;
+    }
+
+    // the error message of the connection is copied to the result if the commands could not be sent
+    return rv ? rv : PQmakeEmptyPGresult(pc, PGRES_FATAL_ERROR);
+}
+
+PGresult* QorePgsqlStatement::getResult(int sent, bool stream, int64 timeout_ms) {
+    PGconn* pc = conn->get();
+    // the error message of the connection is copied to the result
+    if (!sent)
+        return PQmakeEmptyPGresult(pc, PGRES_FATAL_ERROR);
+
+    if (stream) {
+#ifdef LIBPQ_HAS_CHUNK_MODE
+        if (!single_row)
+            PQsetChunkedRowsMode(pc, QORE_PG_STREAM_CHUNK_ROWS);
+        else
+#endif
+            PQsetSingleRowMode(pc);
+    }
+
+    // when streaming, the timeout applies until the first rows are returned
+    PGresult* rv = timeout_ms ? conn->getTimedResult(timeout_ms) : PQgetResult(pc);
+    if (stream && qore_pg_is_stream_result(PQresultStatus(rv))) {
+        conn->startStream(this);
+    } else if (conn->getTimeoutState() != QORE_PG_TIMEOUT_RESET) {
+        // the command has already completed; read the end of the results so the connection can be used again
+        while (PGresult* r = PQgetResult(pc))
+            PQclear(r);
+    }
+    return rv;
+}
+
+int QorePgsqlStatement::execIntern(const char* sql, ExceptionSink* xsink, bool stream) {
     assert(!res);
+    if (conn->checkStream(this, xsink))
+        return -1;
     //printd(5, "QorePgsqlStatement::execIntern() this: %p sql: %s nParams: %d\n", this, sql, nParams);
-    res = PQexecParams(conn->get(), sql, nParams, paramTypes, paramValues, paramLengths, paramFormats, 1);
+    res = execCmd(sql, stream);
     ExecStatusType rc = PQresultStatus(res);
     //printd(5, "QorePgsqlStatement::execIntern() rc: %d\n", rc);
-    if (rc == PGRES_COMMAND_OK || rc == PGRES_TUPLES_OK) {
+    if (rc == PGRES_COMMAND_OK || rc == PGRES_TUPLES_OK || qore_pg_is_stream_result(rc)) {
+        // the savepoint for a streamed query is only needed while rows are being streamed
+        if (!conn->isStreamOwner(this))
+            conn->releaseStreamSavepoint(false);
         return 0;
     }
+    // the savepoint is not released after an error, as the transaction is no longer valid anyway, and the error
+    // message of the connection must be kept
+    conn->discardStreamSavepoint();
 
     bool lost_connection = false;
     // check if we have disconnected from the server
     if (rc == PGRES_FATAL_ERROR) {
         ConnStatusType cs = PQstatus(conn->get());
         //printd(5, "QorePgsqlStatement::execIntern() this: %p status: %d (OK: %d, BAD: %d)\n", this, cs, CONNECTION_OK, CONNECTION_BAD);
-        // try to reestablish the connection
-        if (cs == CONNECTION_BAD) {
+        // try to reestablish the connection; the connection may also be incomplete after a failed reconnect, or it
+        // may be stuck in pipeline mode with results pending after sending a deferred BEGIN
+        if (cs != CONNECTION_OK || PQpipelineStatus(conn->get()) != PQ_PIPELINE_OFF) {
             lost_connection = true;
             // first check if a transaction was in progress
             bool in_trans = conn->wasInTransaction();
@@ -1748,13 +2248,29 @@ int QorePgsqlStatement::execIntern(const char* sql, ExceptionSink* xsink) {
 
             printd(5, "QorePgsqlStatement::execIntern() this: %p connection to server lost (transaction status: %d); " \
                 "trying to reconnect; current sql: %s\n", this, in_trans, sql);
-            PQreset(conn->get());
+            int reset_rc = conn->reset();
+            // the statement cache was cleared with the reset
+            if (pstmt_cached)
+                pstmt = conn->getCachedStatement(sql, nParams, paramTypes);
 
-            // only execute again if the connection was not aborted while in a transaction
+            // only execute again if the connection was not aborted while in a transaction; any server-side
+            // prepared statement is transparently prepared again on the new connection
             if (!in_trans) {
                 PQclear(res);
-                res = PQexecParams(conn->get(), sql, nParams, paramTypes, paramValues, paramLengths, paramFormats, 1);
+                if (reset_rc) {
+                    res = nullptr;
+                    conn->doReconnectError(xsink);
+                    return -1;
+                }
+                res = execCmd(sql, stream);
             }
+        } else if (conn->getTimeoutState() == QORE_PG_TIMEOUT_RESET) {
+            printd(5, "QorePgsqlStatement::execIntern() this: %p the server did not respond to the cancel request; "
+                "resetting the connection; current sql: %s\n", this, sql);
+            conn->reset();
+            // the statement cache was cleared with the reset
+            if (pstmt_cached)
+                pstmt = conn->getCachedStatement(sql, nParams, paramTypes);
         }
     }
 
@@ -1770,118 +2286,1762 @@ int QorePgsqlStatement::exec(const QoreString* str, const QoreListNode* args, Ex
     if (parse(qstr.get(), args, xsink))
         return -1;
 
-    printd(5, "QorePgsqlStatement::exec() nParams: %d args: %p (len: %d) sql: %s\n", nParams, args, args ? args->size() : 0, qstr->c_str());
+    printd(5, "QorePgsqlStatement::exec() nParams: %d args: %p (len: %d) sql: %s\n", nParams, args, args ? args->size() : 0, qstr->c_str());
+
+    // use a cached server-side prepared statement if the statement cache is enabled
+    assert(!pstmt);
+    pstmt = conn->getCachedStatement(qstr->c_str(), nParams, paramTypes);
+    pstmt_cached = (bool)pstmt;
+
+    return execIntern(qstr->c_str(), xsink);
+}
+
+int QorePgsqlStatement::exec(const char* cmd, ExceptionSink *xsink) {
+    assert(!nParams && !paramTypes && !paramValues && !paramLengths && !paramFormats);
+    return execIntern(cmd, xsink);
+}
+
+int64 QorePgsqlStatement::execToStream(const QoreString* str, const QoreListNode* args, OutputStream* os,
+        ExceptionSink* xsink) {
+    std::unique_ptr<QoreString> qstr(str->convertEncoding(enc, xsink));
+    if (!qstr.get() || parse(qstr.get(), args, xsink))
+        return -1;
+
+    // each row is retrieved in its own result, so only one value has to be held in memory at a time
+    single_row = true;
+    if (execIntern(qstr->c_str(), xsink, true))
+        return -1;
+
+    bool streaming = conn->isStreamOwner(this);
+    int64 rows = 0;
+    if (PQnfields(res) != 1) {
+        xsink->raiseException("DBI:PGSQL:ERROR", "the query must return a single column; got %d columns",
+            PQnfields(res));
+    } else {
+        switch (PQftype(res, 0)) {
+            // the binary format of these types is the same as the text value
+            case BYTEAOID:
+            case TEXTOID:
+            case VARCHAROID:
+            case BPCHAROID:
+            case JSONOID:
+            case XMLOID:
+                break;
+            default:
+                xsink->raiseException("DBI:PGSQL:ERROR", "the query must return a bytea or text column; got column "
+                    "'%s' with type OID %d", PQfname(res, 0), (int)PQftype(res, 0));
+                break;
+        }
+    }
+
+    while (!*xsink) {
+        int n = PQntuples(res);
+        for (int i = 0; i < n; ++i, ++rows) {
+            if (PQgetisnull(res, i, 0))
+                continue;
+            // the value is written from the result buffer without being copied
+            const char* p = PQgetvalue(res, i, 0);
+            int64 len = PQgetlength(res, i, 0);
+            while (len) {
+                int64 size = len > QORE_PG_STREAM_WRITE_SIZE ? QORE_PG_STREAM_WRITE_SIZE : len;
+                os->write(p, size, xsink);
+                if (*xsink)
+                    break;
+                p += size;
+                len -= size;
+            }
+            if (*xsink)
+                break;
+        }
+        if (*xsink || !streaming)
+            break;
+
+        PQclear(res);
+        res = PQgetResult(conn->get());
+        if (!qore_pg_is_stream_result(PQresultStatus(res))) {
+            // the stream is complete or an error occurred
+            streaming = false;
+            // the error is raised before the stream is stopped, as the error message of the connection is replaced
+            // when the savepoint for the stream is released
+            int rc = conn->checkClearResult(false, res, xsink);
+            conn->stopStream(false);
+            if (rc)
+                break;
+        }
+    }
+    // cancel the query on the server unless it would invalidate the current transaction
+    if (streaming)
+        conn->stopStream(true);
+
+    return *xsink ? -1 : rows;
+}
+
+DateTimeNode* QorePgsqlLocalTimeCache::make(const AbstractQoreZoneInfo* zone, int64 secs, int us) {
+    if (us < 0 || us >= 1000000) {
+        int64 adj = us / 1000000 - (us % 1000000 < 0 ? 1 : 0);
+        secs += adj;
+        us -= (int)(adj * 1000000);
+    }
+    int64 hour = secs >= 0 ? secs / 3600 : -((-secs + 3599) / 3600);
+    entry& e = cache[(uint64_t)hour % QORE_PG_LOCAL_TIME_CACHE_SIZE];
+    if (!e.valid || e.zone != zone || e.hour != hour) {
+        // the difference to UTC is fixed for the hour if the first and last second of the hour are an hour apart in
+        // UTC
+        int64 start = hour * 3600;
+        ReferenceHolder<DateTimeNode> first(DateTimeNode::makeAbsoluteLocal(zone, start, 0), nullptr);
+        ReferenceHolder<DateTimeNode> last(DateTimeNode::makeAbsoluteLocal(zone, start + 3599, 0), nullptr);
+        int64 utc = first->getEpochSecondsUTC();
+        e.valid = true;
+        e.zone = zone;
+        e.hour = hour;
+        e.shift = start - utc;
+        e.fixed = last->getEpochSecondsUTC() - utc == 3599;
+    }
+    if (!e.fixed)
+        return DateTimeNode::makeAbsoluteLocal(zone, secs, us);
+    return DateTimeNode::makeAbsolute(zone, secs - e.shift, us);
+}
+
+QorePGConnection::QorePGConnection(Datasource* d, const char* str, ExceptionSink *xsink)
+        : ds(d), conninfo(str), pc(qore_pg_handle_pool.get(conninfo)), server_tz(currentTZ()),
+            interval_has_day(false),
+            integer_datetimes(false),
+            decoders(&QorePgsqlStatement::getDecoderTable(true, true)),
+            numeric_support(OPT_NUM_DEFAULT) {
+    nextTransaction();
+    if (PQstatus(pc) != CONNECTION_OK) {
+        doError(nullptr, xsink);
+        return;
+    }
+    cancel_handle->set(pc);
+
+    setup(true, xsink);
+}
+
+int QorePGConnection::setup(bool initial, ExceptionSink* xsink) {
+    const char* pstr;
+    // get server version to encode/decode binary values properly
+    int server_version = PQserverVersion(pc);
+    //printd(5, "version: %d\n", server_version);
+    interval_has_day = server_version >= 80100 ? true : false;
+    pstr = PQparameterStatus(pc, "integer_datetimes");
+
+    if (!pstr || !pstr[0]) {
+        // only very old servers do not report the parameter; the server is only queried for the first connection,
+        // as commands cannot be executed while the connection is being reset
+        if (initial) {
+            // encoding does not matter here; we are only getting an integer
+            QorePgsqlStatement res(this, QCS_DEFAULT);
+            integer_datetimes = res.checkIntegerDateTimes(xsink);
+        }
+    } else
+        integer_datetimes = strcmp(pstr, "off");
+    decoders = &QorePgsqlStatement::getDecoderTable(integer_datetimes, interval_has_day);
+
+    // the client encoding is not part of the connection parameters, so it must be set again after a reset
+    if (PQsetClientEncoding(pc, ds->getDBEncoding())) {
+        xsink->raiseException("DBI:PGSQL:ENCODING-ERROR", "invalid PostgreSQL encoding '%s'", ds->getDBEncoding());
+        return -1;
+    }
+    return *xsink ? -1 : 0;
+}
+
+QorePGConnection::~QorePGConnection() {
+    // cancel requests sent from other threads are ignored from now on
+    cancel_handle->set(nullptr);
+    // the connection can only be reused if no command is in progress
+    if (pc)
+        qore_pg_handle_pool.release(conninfo, pc, !isBusy());
+}
+
+void QorePGConnection::nextTransaction() {
+    trans_serial = ++trans_seq;
+}
+
+int QorePGConnection::commit(ExceptionSink *xsink) {
+    nextTransaction();
+    // nothing has been sent to the server in the transaction, or it has already been committed with a batch
+    if (begin_pending || commit_pipelined) {
+        begin_pending = commit_pipelined = false;
+        deallocatePending();
+        return 0;
+    }
+    QorePgsqlStatement res(this, ds->getQoreEncoding());
+    res.disableTimeout();
+    int rc = res.exec("commit", xsink);
+    deallocatePending();
+    return rc;
+}
+
+int QorePGConnection::rollback(ExceptionSink *xsink) {
+    nextTransaction();
+    // any rows still being streamed are discarded with the transaction, as is any COPY in progress; the savepoint
+    // for the stream is discarded with the transaction as well
+    if (stream_stmt) {
+        discardStreamSavepoint();
+        cancel();
+        stopStream(false);
+    }
+    else if (copy_stmt)
+        abortCopy("COPY aborted by transaction rollback", true);
+    else if (async_stmt)
+        abortAsync(true);
+    // nothing has been sent to the server in the transaction
+    commit_pipelined = false;
+    if (begin_pending) {
+        begin_pending = false;
+        deallocatePending();
+        return 0;
+    }
+    QorePgsqlStatement res(this, ds->getQoreEncoding());
+    res.disableTimeout();
+    int rc = res.exec("rollback", xsink);
+    deallocatePending();
+    return rc;
+}
+
+int QorePGConnection::begin_transaction(ExceptionSink *xsink) {
+    nextTransaction();
+    commit_pipelined = false;
+    // BEGIN is sent with the first command of the transaction
+    if (deferred_begin) {
+        begin_pending = true;
+        return 0;
+    }
+    QorePgsqlStatement res(this, ds->getQoreEncoding());
+    res.disableTimeout();
+    return res.exec("begin", xsink);
+}
+
+PGresult* QorePGConnection::execBegin() {
+    begin_pending = false;
+    PGresult* res = PQexec(pc, "begin");
+    if (PQresultStatus(res) == PGRES_COMMAND_OK) {
+        PQclear(res);
+        return nullptr;
+    }
+    return res;
+}
+
+int QorePGConnection::flushBegin(ExceptionSink* xsink) {
+    if (!begin_pending)
+        return 0;
+    PGresult* res = execBegin();
+    return res ? checkClearResult(false, res, xsink) : 0;
+}
+
+QoreListNode* QorePGConnection::selectRows(const QoreString* qstr, const QoreListNode* args, ExceptionSink *xsink) {
+    QorePgsqlStatement res(this, ds->getQoreEncoding());
+    if (res.exec(qstr, args, xsink))
+        return NULL;
+
+    return res.getOutputList(xsink);
+}
+
+QoreHashNode* QorePGConnection::selectRow(const QoreString* qstr, const QoreListNode* args, ExceptionSink *xsink) {
+    QorePgsqlStatement res(this, ds->getQoreEncoding());
+    if (res.exec(qstr, args, xsink))
+        return NULL;
+
+    return res.getSingleRow(xsink);
+}
+
+QoreValue QorePGConnection::select(const QoreString* qstr, const QoreListNode* args, ExceptionSink *xsink) {
+    QorePgsqlStatement res(this, ds->getQoreEncoding());
+    if (res.exec(qstr, args, xsink))
+        return QoreValue();
+
+    if (res.hasResultData())
+        return res.getOutputHash(xsink, true);
+
+    return res.rowsAffected();
+}
+
+QoreValue QorePGConnection::exec(const QoreString* qstr, const QoreListNode* args, ExceptionSink *xsink) {
+    QorePgsqlStatement res(this, ds->getQoreEncoding());
+    if (res.exec(qstr, args, xsink))
+        return QoreValue();
+
+    if (res.hasResultData())
+        return res.getOutputHash(xsink);
+
+    return res.rowsAffected();
+}
+
+QoreValue QorePGConnection::execRaw(const QoreString* qstr, ExceptionSink *xsink) {
+    QorePgsqlStatement res(this, ds->getQoreEncoding());
+    // convert string to required character encoding or copy
+    std::unique_ptr<QoreString> ccstr(qstr->convertEncoding(ds->getQoreEncoding(), xsink));
+
+    if (res.exec(ccstr->c_str(), xsink))
+        return QoreValue();
+
+    if (res.hasResultData())
+        return res.getOutputHash(xsink);
+
+    return res.rowsAffected();
+}
+
+int QorePGConnection::get_server_version() const {
+    return PQserverVersion(pc);
+}
+
+int QorePGConnection::reset() {
+    // the cancel object refers to the old server process; cancel requests are ignored while reconnecting
+    cancel_handle->set(nullptr);
+    int rc = reconnect();
+    if (!rc)
+        cancel_handle->set(pc);
+    // all server-side prepared statements are lost with the old connection, as is any transaction
+    ++gen;
+    nextTransaction();
+    pending_dealloc.clear();
+    stmt_cache.clear();
+    stream_stmt = nullptr;
+    stream_savepoint = false;
+    copy_stmt = nullptr;
+    async_stmt = nullptr;
+    // a transaction not yet started on the server is lost like any other transaction
+    begin_pending = false;
+    commit_pipelined = false;
+    return rc;
+}
+
+// returns the connect_timeout parameter of the connection in milliseconds; 0 = no limit
+static int64 qore_pg_get_connect_timeout(PGconn* pc) {
+    PQconninfoOption* opts = PQconninfo(pc);
+    if (!opts)
+        return 0;
+    int64 rv = 0;
+    for (PQconninfoOption* o = opts; o->keyword; ++o) {
+        if (!strcmp(o->keyword, "connect_timeout")) {
+            // libpq treats values less than 2 seconds as 2 seconds and values of 0 or less as no limit
+            int secs = o->val ? atoi(o->val) : 0;
+            if (secs > 0)
+                rv = (secs < 2 ? 2 : secs) * 1000;
+            break;
+        }
+    }
+    PQconninfoFree(opts);
+    return rv;
+}
+
+int QorePGConnection::reconnect() {
+    // fail immediately while reconnects to the server are suspended after a failed reconnect
+    std::string err;
+    if (reconnect_backoff_map.check(conninfo, err)) {
+        reconnect_error = "reconnects to the server are suspended after a failed reconnect; last error: " + err;
+        printd(5, "QorePGConnection::reconnect() this: %p %s\n", this, reconnect_error.c_str());
+        return -1;
+    }
+
+    // the connection is reestablished without blocking so that the wait can be limited by the reconnect timeout;
+    // libpq does not apply connect_timeout when polling, so it's used as the limit if no reconnect timeout is set
+    reconnect_error.clear();
+    int64 timeout = reconnect_timeout ? reconnect_timeout : qore_pg_get_connect_timeout(pc);
+    int rc = -1;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    if (PQresetStart(pc)) {
+        while (true) {
+            PostgresPollingStatusType ps = PQresetPoll(pc);
+            if (ps == PGRES_POLLING_OK) {
+                rc = 0;
+                break;
+            }
+            if (ps == PGRES_POLLING_FAILED)
+                break;
+
+            int64 remaining = -1;
+            if (timeout) {
+                remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline
+                    - std::chrono::steady_clock::now()).count();
+                if (remaining <= 0) {
+                    reconnect_error = "the reconnect did not complete within " + std::to_string(timeout) + " ms";
+                    break;
+                }
+            }
+            if (waitSocket(ps == PGRES_POLLING_WRITING, remaining) < 0)
+                break;
+        }
+    }
+
+    if (!rc) {
+        ExceptionSink xsink;
+        if (setup(false, &xsink)) {
+            xsink.clear();
+            reconnect_error = "the connection could not be set up after reconnecting; invalid PostgreSQL "
+                "encoding '" + std::string(ds->getDBEncoding()) + "'";
+            rc = -1;
+        }
+    }
+
+    // notifications are received again on the new connection; any notifications sent in the meantime are lost
+    if (!rc && !listen_channels.empty())
+        rc = replayListen(timeout, deadline);
+
+    if (rc) {
+        if (reconnect_error.empty()) {
+            QoreString msg(PQerrorMessage(pc));
+            msg.chomp();
+            reconnect_error = msg.c_str();
+        }
+        printd(5, "QorePGConnection::reconnect() this: %p reconnect failed: %s\n", this, reconnect_error.c_str());
+        reconnect_backoff_map.failed(conninfo, reconnect_backoff, reconnect_error.c_str());
+        return -1;
+    }
+
+    reconnect_backoff_map.succeeded(conninfo);
+    return 0;
+}
+
+int QorePGConnection::replayListen(int64 timeout, std::chrono::steady_clock::time_point deadline) {
+    std::string cmd;
+    for (auto& i : listen_channels)
+        cmd += "listen " + i + ";";
+
+    if (!PQsendQuery(pc, cmd.c_str()))
+        return -1;
+
+    // the results are read within the reconnect timeout
+    int rc = 0;
+    while (true) {
+        while (PQisBusy(pc)) {
+            int64 remaining = -1;
+            if (timeout) {
+                remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline
+                    - std::chrono::steady_clock::now()).count();
+                if (remaining <= 0) {
+                    reconnect_error = "the LISTEN commands could not be executed again within the reconnect "
+                        "timeout of " + std::to_string(timeout) + " ms";
+                    return -1;
+                }
+            }
+            if (waitSocket(false, remaining) < 0 || !PQconsumeInput(pc))
+                return -1;
+        }
+        PGresult* res = PQgetResult(pc);
+        if (!res)
+            break;
+        if (PQresultStatus(res) != PGRES_COMMAND_OK && !rc) {
+            QoreString msg(PQresultErrorMessage(res));
+            msg.chomp();
+            reconnect_error = "the LISTEN commands could not be executed again after reconnecting: "
+                + std::string(msg.c_str());
+            rc = -1;
+        }
+        PQclear(res);
+    }
+    return rc;
+}
+
+void QorePGConnection::doReconnectError(ExceptionSink* xsink) const {
+    xsink->raiseException("DBI:PGSQL:CONNECTION-ERROR", "connection to PostgreSQL database server lost while not "
+        "in a transaction; reconnect failed: %s", reconnect_error.c_str());
+}
+
+bool QorePgsqlReconnectBackoff::check(const std::string& conninfo, std::string& err) {
+    AutoLocker al(m);
+    entry_map_t::iterator i = entry_map.find(conninfo);
+    if (i == entry_map.end() || std::chrono::steady_clock::now() >= i->second.retry)
+        return false;
+    err = i->second.err;
+    return true;
+}
+
+void QorePgsqlReconnectBackoff::failed(const std::string& conninfo, int64 backoff_ms, const char* err) {
+    if (!backoff_ms)
+        return;
+
+    AutoLocker al(m);
+    entry& e = entry_map[conninfo];
+    // the backoff is doubled with each consecutive failure up to the maximum
+    int64 max_ms = std::max(backoff_ms, (int64)QORE_PG_RECONNECT_BACKOFF_MAX);
+    int64 ms = backoff_ms;
+    for (unsigned i = 0; i < e.failures && ms < max_ms; ++i)
+        ms *= 2;
+    ++e.failures;
+    e.retry = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::min(ms, max_ms));
+    e.err = err;
+}
+
+void QorePgsqlReconnectBackoff::succeeded(const std::string& conninfo) {
+    AutoLocker al(m);
+    entry_map.erase(conninfo);
+}
+
+int QorePGConnection::checkStream(const QorePgsqlStatement* stmt, ExceptionSink* xsink) {
+    if (copy_stmt && copy_stmt != stmt) {
+        xsink->raiseException("DBI:PGSQL:COPY-ERROR", "cannot execute a command while a COPY is in progress on the "
+            "same connection; finish or abort the COPY first");
+        return -1;
+    }
+    if (async_stmt && async_stmt != stmt) {
+        xsink->raiseException("DBI:PGSQL:ASYNC-ERROR", "cannot execute a command while an asynchronous query is in "
+            "progress on the same connection; retrieve the query's result first");
+        return -1;
+    }
+    if (!stream_stmt || stream_stmt == stmt)
+        return 0;
+    xsink->raiseException("DBI:PGSQL:STREAM-ERROR", "cannot execute a command while an SQLStatement is streaming "
+        "results on the same connection; retrieve all rows or close the SQLStatement first");
+    return -1;
+}
+
+void QorePGConnection::stopStream(bool cancel) {
+    assert(stream_stmt);
+    // canceling the query in a transaction requires a savepoint, as the error would otherwise abort the
+    // transaction; without one, the remaining rows are read and discarded
+    cancel = cancel && (stream_savepoint || !wasInTransaction());
+    if (cancel)
+        this->cancel();
+    while (PGresult* r = PQgetResult(pc))
+        PQclear(r);
+    stream_stmt = nullptr;
+    releaseStreamSavepoint(cancel);
+    deallocatePending();
+}
+
+PGresult* QorePGConnection::setStreamSavepoint() {
+    assert(!stream_savepoint);
+    if (!wasInTransaction())
+        return nullptr;
+    PGresult* res = PQexec(pc, "savepoint " QORE_PG_STREAM_SAVEPOINT);
+    if (PQresultStatus(res) != PGRES_COMMAND_OK)
+        return res;
+    PQclear(res);
+    stream_savepoint = true;
+    return nullptr;
+}
+
+void QorePGConnection::releaseStreamSavepoint(bool rollback) {
+    if (!stream_savepoint)
+        return;
+    stream_savepoint = false;
+    // errors are ignored; they can only occur if the transaction has already been invalidated by the query
+    PQclear(PQexec(pc, rollback
+        ? "rollback to savepoint " QORE_PG_STREAM_SAVEPOINT "; release savepoint " QORE_PG_STREAM_SAVEPOINT
+        : "release savepoint " QORE_PG_STREAM_SAVEPOINT));
+}
+
+int QorePGConnection::endCopy(PGresult*& res, ExceptionSink* xsink) {
+    assert(copy_stmt);
+    copy_stmt = nullptr;
+    res = PQgetResult(pc);
+    // read the end of the results so the connection can be used again
+    while (PGresult* r = PQgetResult(pc))
+        PQclear(r);
+    int rc = checkClearResult(false, res, xsink);
+    deallocatePending();
+    return rc;
+}
+
+void QorePgsqlCancel::set(PGconn* pc) {
+    std::shared_ptr<PGcancel> c;
+    if (pc) {
+        PGcancel* pgc = PQgetCancel(pc);
+        if (pgc)
+            c.reset(pgc, PQfreeCancel);
+    }
+    // the old cancel object is freed when the last request using it has been sent, outside the lock
+    AutoLocker al(m);
+    pg_cancel.swap(c);
+}
+
+void QorePgsqlCancel::cancel() {
+    std::shared_ptr<PGcancel> c;
+    {
+        AutoLocker al(m);
+        c = pg_cancel;
+    }
+    if (!c)
+        return;
+    // PQcancel() is thread-safe; the lock is not held while waiting for the server
+    char errbuf[256];
+    if (!PQcancel(c.get(), errbuf, sizeof(errbuf)))
+        printd(5, "QorePgsqlCancel::cancel() cancel failed: %s\n", errbuf);
+}
+
+int QorePGConnection::waitResult(int64 timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true) {
+        if (!PQconsumeInput(pc))
+            return -1;
+        if (!PQisBusy(pc))
+            return 1;
+
+        int64 remaining = -1;
+        if (timeout_ms >= 0) {
+            remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline
+                - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0)
+                return 0;
+        }
+        if (waitSocket(false, remaining) < 0)
+            return -1;
+    }
+}
+
+PGresult* QorePGConnection::getTimedResult(int64 timeout_ms) {
+    timeout_state = QORE_PG_TIMEOUT_NONE;
+    int rc = waitResult(timeout_ms);
+    if (!rc) {
+        printd(5, "QorePGConnection::getTimedResult() timeout of " QLLD " ms expired; canceling the command\n",
+            timeout_ms);
+        cancel();
+        rc = waitResult(QORE_PG_CANCEL_WAIT_MS);
+        if (!rc) {
+            // the connection cannot be used until the command ends; the caller must reset it
+            timeout_state = QORE_PG_TIMEOUT_RESET;
+            return PQmakeEmptyPGresult(pc, PGRES_FATAL_ERROR);
+        }
+        if (rc > 0) {
+            PGresult* rv = PQgetResult(pc);
+            // the command may have ended before the cancel request was processed
+            const char* state = PQresultErrorField(rv, PG_DIAG_SQLSTATE);
+            if (state && !strcmp(state, "57014"))
+                timeout_state = QORE_PG_TIMEOUT_CANCELED;
+            return rv;
+        }
+    }
+    // the error message of the connection is copied to the result if the connection was lost
+    return rc < 0 ? PQmakeEmptyPGresult(pc, PGRES_FATAL_ERROR) : PQgetResult(pc);
+}
+
+int QorePGConnection::doTimeoutError(const PGresult* res, ExceptionSink* xsink) {
+    bool was_reset = timeout_state == QORE_PG_TIMEOUT_RESET;
+    timeout_state = QORE_PG_TIMEOUT_NONE;
+    doTimeoutError(query_timeout, was_reset, was_reset ? nullptr : res, xsink);
+    return -1;
+}
+
+void QorePGConnection::doTimeoutError(int64 timeout_ms, bool was_reset, const PGresult* res,
+        ExceptionSink* xsink) {
+    QoreStringNode* desc = new QoreStringNodeMaker("the command did not complete within the timeout of " QLLD
+        " ms and was canceled", timeout_ms);
+    if (was_reset)
+        desc->concat("; the server did not respond to the cancel request, so the connection was reset and any "
+            "transaction in progress was lost");
+    xsink->raiseExceptionArg("DBI:PGSQL:TIMEOUT", res ? getExceptionArg(res, xsink) : nullptr, desc);
+}
+
+void QorePGConnection::abortAsync(bool rollback) {
+    assert(async_stmt);
+    // cancel the query on the server unless it would invalidate a transaction that is not being rolled back
+    if (PQisBusy(pc) && (rollback || !wasInTransaction()))
+        cancel();
+    while (PGresult* r = PQgetResult(pc))
+        PQclear(r);
+    async_stmt = nullptr;
+    deallocatePending();
+}
+
+void QorePGConnection::abortCopy(const char* msg, bool rollback) {
+    assert(copy_stmt);
+    if (copy_in) {
+        if (PQputCopyEnd(pc, msg) <= 0) {
+            copy_stmt = nullptr;
+            return;
+        }
+    } else {
+        // cancel the query on the server unless it would invalidate a transaction that is not being rolled back
+        if (rollback || !wasInTransaction())
+            cancel();
+        // read and discard the rest of the data
+        char* buf;
+        while (PQgetCopyData(pc, &buf, 0) > 0)
+            PQfreemem(buf);
+    }
+    while (PGresult* r = PQgetResult(pc))
+        PQclear(r);
+    copy_stmt = nullptr;
+    deallocatePending();
+}
+
+int QorePgsqlBatchStatement::prepare(const QoreString& str, const QoreListNode* args, ExceptionSink* xsink) {
+    // convert string to required character encoding or copy
+    sql.reset(str.convertEncoding(enc, xsink));
+    if (!sql)
+        return -1;
+
+    return parse(sql.get(), args, xsink);
+}
+
+int QorePgsqlBatchStatement::send() {
+    return PQsendQueryParams(conn->get(), sql->c_str(), nParams, paramTypes, paramValues, paramLengths, paramFormats,
+        1) ? 0 : -1;
+}
+
+QoreValue QorePgsqlBatchStatement::getResult(PGresult* r, ExceptionSink* xsink) {
+    assert(!res);
+    res = r;
+    if (hasResultData())
+        return getOutputHash(xsink);
+    return rowsAffected();
+}
+
+// appends the given name quoted as an identifier to the string; returns 0 for OK, -1 for error
+static int qore_pg_concat_ident(PGconn* pc, QoreString& str, const char* name, size_t len, ExceptionSink* xsink) {
+    char* p = PQescapeIdentifier(pc, name, len);
+    if (!p) {
+        QoreString msg(PQerrorMessage(pc));
+        msg.chomp();
+        xsink->raiseException("DBI:PGSQL:COPY-ERROR", "invalid column name '%s': %s", name, msg.c_str());
+        return -1;
+    }
+    str.concat(p);
+    PQfreemem(p);
+    return 0;
+}
+
+int QorePgsqlCopyIn::start(const QoreString& table, const QoreListNode* columns, ExceptionSink* xsink) {
+    TempEncodingHelper tbl(table, enc, xsink);
+    if (!tbl)
+        return -1;
+
+    if (conn->checkStream(this, xsink) || conn->flushBegin(xsink))
+        return -1;
+
+    PGconn* pc = conn->get();
+    QoreString cols(enc);
+    if (columns && !columns->empty()) {
+        ConstListIterator li(columns);
+        while (li.next()) {
+            QoreStringValueHelper col(li.getValue(), enc, xsink);
+            if (*xsink)
+                return -1;
+            if (!cols.empty())
+                cols.concat(", ");
+            if (qore_pg_concat_ident(pc, cols, col->c_str(), col->size(), xsink))
+                return -1;
+        }
+    } else {
+        cols.concat('*');
+    }
+
+    // get the names and types of the target columns; binary COPY data must match the column types exactly; the
+    // query is sent as-is, as the table name is raw SQL that may contain characters used for placeholders
+    QoreStringMaker cmd("select %s from %s limit 0", cols.c_str(), tbl->c_str());
+    res = PQexec(pc, cmd.c_str());
+    if (conn->checkClearResult(false, res, xsink))
+        return -1;
+
+    // generated columns cannot be copied into, so they are excluded from the default column list
+    std::unordered_set<std::string> generated;
+    if (!columns || columns->empty()) {
+        cols.clear();
+        if (PQserverVersion(pc) >= 120000) {
+            char* lit = PQescapeLiteral(pc, tbl->c_str(), tbl->size());
+            if (!lit) {
+                QorePgsqlStatement::reset();
+                return conn->doError(nullptr, xsink);
+            }
+            QoreStringMaker gcmd("select attname from pg_catalog.pg_attribute where attrelid = %s::regclass "
+                "and attnum > 0 and not attisdropped and attgenerated <> ''", lit);
+            PQfreemem(lit);
+            PGresult* gres = PQexec(pc, gcmd.c_str());
+            if (conn->checkClearResult(false, gres, xsink)) {
+                QorePgsqlStatement::reset();
+                return -1;
+            }
+            for (int i = 0, e = PQntuples(gres); i < e; ++i)
+                generated.insert(PQgetvalue(gres, i, 0));
+            PQclear(gres);
+        }
+    }
+
+    int nfields = PQnfields(res);
+    for (int i = 0; i < nfields; ++i) {
+        const char* name = PQfname(res, i);
+        if (!generated.empty() && generated.find(name) != generated.end())
+            continue;
+        if (!columns || columns->empty()) {
+            if (!cols.empty())
+                cols.concat(", ");
+            if (qore_pg_concat_ident(pc, cols, name, strlen(name), xsink)) {
+                QorePgsqlStatement::reset();
+                return -1;
+            }
+        }
+        names.push_back(name);
+        types.push_back(PQftype(res, i));
+    }
+    QorePgsqlStatement::reset();
+
+    // the column list is always given, so that the COPY data matches the columns probed above
+    QoreStringMaker copy("copy %s (%s) from stdin (format binary)", tbl->c_str(), cols.c_str());
+    res = PQexec(pc, copy.c_str());
+    if (PQresultStatus(res) != PGRES_COPY_IN)
+        return conn->checkClearResult(false, res, xsink) ? -1 : conn->doError(nullptr, xsink);
+    PQclear(res);
+    res = nullptr;
+    conn->startCopy(this, true);
+
+    // the binary COPY header: signature, flags, and header extension length
+    buf.assign("PGCOPY\n\377\r\n\0", 11);
+    buf.append(8, '\0');
+    return 0;
+}
+
+int QorePgsqlCopyIn::checkActive(ExceptionSink* xsink) const {
+    if (active())
+        return 0;
+    xsink->raiseException("DBI:PGSQL:COPY-ERROR", "the COPY is no longer in progress");
+    return -1;
+}
+
+void QorePgsqlCopyIn::addField(const void* data, int len) {
+    int32_t nlen = htonl(len);
+    buf.append((const char*)&nlen, sizeof(nlen));
+    if (len > 0)
+        buf.append((const char*)data, len);
+}
+
+static bool qore_pg_is_text_type(Oid type) {
+    switch (type) {
+        case TEXTOID:
+        case VARCHAROID:
+        case BPCHAROID:
+        case NAMEOID:
+        case JSONOID:
+        case XMLOID:
+            return true;
+    }
+    return false;
+}
+
+int QorePgsqlCopyIn::addValue(size_t col, QoreValue v, ExceptionSink* xsink) {
+    // encode the value with the same binary encoding used for bound values
+    QorePgsqlStatement::reset();
+    if (add(v, xsink))
+        return -1;
+
+    if (!paramValues[0]) {
+        addField(nullptr, -1);
+        return 0;
+    }
+
+    Oid type = types[col];
+    Oid vtype = paramTypes[0];
+    // the text encoding of text types is also their binary encoding
+    bool text = !paramFormats[0];
+    if (vtype == type && (!text || qore_pg_is_text_type(type))) {
+        addField(paramValues[0], paramLengths[0]);
+        return 0;
+    }
+
+    // convert the value to the binary encoding of the column's type
+    bool numeric = vtype == INT2OID || vtype == INT4OID || vtype == INT8OID || vtype == FLOAT8OID
+        || vtype == NUMERICOID;
+    switch (type) {
+        case INT2OID:
+        case INT4OID:
+        case INT8OID: {
+            if (vtype != INT2OID && vtype != INT4OID && vtype != INT8OID)
+                break;
+            int64 i = v.getAsBigInt();
+            if (type == INT8OID) {
+                int64 val = i8MSB(i);
+                addField(&val, sizeof(val));
+                return 0;
+            }
+            if (type == INT4OID && i <= 2147483647 && i >= -2147483648LL) {
+                int32_t val = htonl((int32_t)i);
+                addField(&val, sizeof(val));
+                return 0;
+            }
+            if (type == INT2OID && i <= 32767 && i >= -32768) {
+                int16_t val = htons((int16_t)i);
+                addField(&val, sizeof(val));
+                return 0;
+            }
+            xsink->raiseException("DBI:PGSQL:COPY-ERROR", "value " QLLD " is out of range for column '%s' with "
+                "type %s", i, names[col].c_str(), type == INT4OID ? "integer" : "smallint");
+            return -1;
+        }
+
+        case FLOAT4OID:
+        case FLOAT8OID: {
+            if (!numeric)
+                break;
+            if (type == FLOAT8OID) {
+                double val = f8MSB(v.getAsFloat());
+                addField(&val, sizeof(val));
+                return 0;
+            }
+            float f = (float)v.getAsFloat();
+            uint32_t val;
+            memcpy(&val, &f, sizeof(val));
+            val = htonl(val);
+            addField(&val, sizeof(val));
+            return 0;
+        }
+
+        case NUMERICOID: {
+            if (vtype == INT2OID || vtype == INT4OID || vtype == INT8OID) {
+                qore_pg_numeric_out num(v.getAsBigInt());
+                addField(num.getData(), num.getSize());
+                return 0;
+            }
+            ReferenceHolder<QoreNumberNode> n(xsink);
+            if (vtype == FLOAT8OID)
+                n = new QoreNumberNode(v.getAsFloat());
+            else if (text)
+                n = new QoreNumberNode(paramValues[0]);
+            else
+                break;
+            qore_pg_numeric_out num;
+            if (num.set(*n, xsink))
+                return -1;
+            addField(num.getData(), num.getSize());
+            return 0;
+        }
+
+        case JSONBOID: {
+            if (!text)
+                break;
+            // the binary format of jsonb is a version number followed by the text
+            int32_t nlen = htonl(paramLengths[0] + 1);
+            buf.append((const char*)&nlen, sizeof(nlen));
+            buf.append(1, '\1');
+            buf.append(paramValues[0], paramLengths[0]);
+            return 0;
+        }
+
+        case TIMESTAMPOID:
+        case DATEOID: {
+            if (vtype != TIMESTAMPTZOID || !conn->has_integer_datetimes())
+                break;
+            // timestamp and date values are stored as local time in the server's time zone
+            const DateTimeNode* d = v.get<const DateTimeNode>();
+            ReferenceHolder<DateTimeNode> local(DateTimeNode::makeAbsolute(conn->getTZ(), d->getEpochSecondsUTC(),
+                d->getMicrosecond()), xsink);
+            int64 secs = local->getEpochSeconds() - PGSQL_EPOCH_OFFSET;
+            if (type == TIMESTAMPOID) {
+                int64 val = i8MSB(secs * 1000000 + d->getMicrosecond());
+                addField(&val, sizeof(val));
+                return 0;
+            }
+            int64 days = secs / 86400;
+            if (secs < 0 && (secs % 86400))
+                --days;
+            int32_t val = htonl((int32_t)days);
+            addField(&val, sizeof(val));
+            return 0;
+        }
+
+        default:
+            // any value can be copied to a text column with its string representation
+            if (qore_pg_is_text_type(type) && v.getType() != NT_HASH) {
+                QoreStringValueHelper str(v, enc, xsink);
+                if (*xsink)
+                    return -1;
+                addField(str->c_str(), str->size());
+                return 0;
+            }
+            break;
+    }
+
+    xsink->raiseException("DBI:PGSQL:COPY-ERROR", "cannot encode a value of type '%s' for column '%s' with type "
+        "OID %d in the binary COPY format; values in text form can only be copied to text columns",
+        v.getFullTypeName(), names[col].c_str(), (int)type);
+    return -1;
+}
+
+int QorePgsqlCopyIn::addRow(const QoreListNode& row, ExceptionSink* xsink) {
+    if (checkActive(xsink))
+        return -1;
+    if (row.size() != names.size()) {
+        xsink->raiseException("DBI:PGSQL:COPY-ERROR", "the row has %d value%s, but the COPY has %d column%s",
+            (int)row.size(), row.size() == 1 ? "" : "s", (int)names.size(), names.size() == 1 ? "" : "s");
+        return -1;
+    }
+
+    size_t start = buf.size();
+    int16_t n = htons((int16_t)names.size());
+    buf.append((const char*)&n, sizeof(n));
+    ConstListIterator li(row);
+    while (li.next()) {
+        if (addValue(li.index(), li.getValue(), xsink)) {
+            // remove the partial row
+            buf.resize(start);
+            return -1;
+        }
+    }
+    ++rows;
+    return flush(xsink);
+}
+
+int QorePgsqlCopyIn::addRow(const QoreHashNode& row, ExceptionSink* xsink) {
+    if (checkActive(xsink))
+        return -1;
+
+    size_t start = buf.size();
+    int16_t n = htons((int16_t)names.size());
+    buf.append((const char*)&n, sizeof(n));
+    // missing columns are copied as NULL
+    for (size_t i = 0, e = names.size(); i < e; ++i) {
+        if (addValue(i, row.getKeyValue(names[i].c_str()), xsink)) {
+            buf.resize(start);
+            return -1;
+        }
+    }
+    ++rows;
+    return flush(xsink);
+}
+
+int QorePgsqlCopyIn::flush(ExceptionSink* xsink, bool force) {
+    if (buf.empty() || (!force && buf.size() < QORE_PG_COPY_BUFFER_SIZE))
+        return 0;
+    if (PQputCopyData(conn->get(), buf.data(), buf.size()) != 1) {
+        // the connection has been lost
+        conn->doError(nullptr, xsink);
+        conn->abortCopy(nullptr);
+        return -1;
+    }
+    buf.clear();
+    return 0;
+}
+
+int64 QorePgsqlCopyIn::finish(ExceptionSink* xsink) {
+    if (checkActive(xsink))
+        return -1;
+
+    // the file trailer
+    int16_t trailer = htons(-1);
+    buf.append((const char*)&trailer, sizeof(trailer));
+    if (flush(xsink, true))
+        return -1;
+
+    if (PQputCopyEnd(conn->get(), nullptr) != 1) {
+        conn->doError(nullptr, xsink);
+        conn->abortCopy(nullptr);
+        return -1;
+    }
+
+    QorePgsqlStatement::reset();
+    if (conn->endCopy(res, xsink))
+        return -1;
+    return strtoll(PQcmdTuples(res), nullptr, 10);
+}
+
+void QorePgsqlCopyIn::abort(const char* msg) {
+    buf.clear();
+    if (active())
+        conn->abortCopy(msg);
+}
+
+int QorePgsqlCopyOut::start(const QoreString& query, ExceptionSink* xsink) {
+    TempEncodingHelper sql(query, enc, xsink);
+    if (!sql)
+        return -1;
+    // the COPY is not sent in pipeline mode, so a deferred BEGIN is sent first
+    if (conn->checkStream(this, xsink) || conn->flushBegin(xsink))
+        return -1;
+
+    // the result columns are described with the unnamed statement, as binary COPY data has no column information
+    PGconn* pc = conn->get();
+    res = PQprepare(pc, "", sql->c_str(), 0, nullptr);
+    if (conn->checkClearResult(false, res, xsink))
+        return -1;
+    PQclear(res);
+    res = PQdescribePrepared(pc, "");
+    if (conn->checkClearResult(false, res, xsink))
+        return -1;
+    int nfields = PQnfields(res);
+    if (!nfields) {
+        xsink->raiseException("DBI:PGSQL:COPY-ERROR", "the query does not return any columns");
+        return -1;
+    }
+    cols = getColumns();
+    QorePgsqlStatement::reset();
+
+    QoreStringMaker cmd("copy (%s) to stdout (format binary)", sql->c_str());
+    res = PQexec(pc, cmd.c_str());
+    if (PQresultStatus(res) != PGRES_COPY_OUT)
+        return conn->checkClearResult(false, res, xsink) ? -1 : conn->doError(nullptr, xsink);
+    PQclear(res);
+    res = nullptr;
+    conn->startCopy(this, false);
+    return 0;
+}
+
+int QorePgsqlCopyOut::getData(ExceptionSink* xsink) {
+    if (cbuf) {
+        PQfreemem(cbuf);
+        cbuf = nullptr;
+    }
+    cpos = 0;
+    clen = PQgetCopyData(conn->get(), &cbuf, 0);
+    if (clen > 0)
+        return 1;
+
+    clen = 0;
+    // -1 = the COPY is complete; -2 = error
+    QorePgsqlStatement::reset();
+    return conn->endCopy(res, xsink) ? -1 : 0;
+}
+
+int QorePgsqlCopyOut::need(int bytes, ExceptionSink* xsink) {
+    if (clen - cpos >= bytes)
+        return 0;
+    // the server sends each row in a single message, so the data can only end at a row boundary
+    xsink->raiseException("DBI:PGSQL:COPY-ERROR", "invalid binary COPY data received from the server: expecting "
+        "%d byte%s, got %d", bytes, bytes == 1 ? "" : "s", clen - cpos);
+    abort();
+    return -1;
+}
+
+template <typename F>
+int QorePgsqlCopyOut::readRow(F f, ExceptionSink* xsink) {
+    if (!active())
+        return 0;
+
+    if (cpos == clen) {
+        int rc = getData(xsink);
+        if (rc <= 0)
+            return rc;
+    }
+
+    if (!header) {
+        // signature, flags, and header extension length
+        if (need(19, xsink))
+            return -1;
+        if (memcmp(cbuf, "PGCOPY\n\377\r\n\0", 11)) {
+            xsink->raiseException("DBI:PGSQL:COPY-ERROR", "invalid binary COPY header received from the server");
+            abort();
+            return -1;
+        }
+        int ext = ntohl(*(uint32_t*)(cbuf + 15));
+        cpos = 19;
+        if (need(ext, xsink))
+            return -1;
+        cpos += ext;
+        header = true;
+        if (cpos == clen) {
+            int rc = getData(xsink);
+            if (rc <= 0)
+                return rc;
+        }
+    }
+
+    if (need(2, xsink))
+        return -1;
+    int16_t nfields = ntohs(*(uint16_t*)(cbuf + cpos));
+    cpos += 2;
+    // the file trailer; the end of the data follows
+    if (nfields == -1) {
+        while (true) {
+            int rc = getData(xsink);
+            if (rc <= 0)
+                return rc;
+        }
+    }
+    if (nfields != (int)cols.size()) {
+        xsink->raiseException("DBI:PGSQL:COPY-ERROR", "received a row with %d columns from the server; expecting %d",
+            nfields, (int)cols.size());
+        abort();
+        return -1;
+    }
+
+    for (int i = 0; i < nfields; ++i) {
+        if (need(4, xsink))
+            return -1;
+        int len = (int32_t)ntohl(*(uint32_t*)(cbuf + cpos));
+        cpos += 4;
+        if (len == -1) {
+            if (f(i, null()))
+                return -1;
+            continue;
+        }
+        if (need(len, xsink))
+            return -1;
+        QoreValue v = decodeValue(cbuf + cpos, cols[i], len, xsink);
+        cpos += len;
+        if (*xsink) {
+            v.discard(xsink);
+            abort();
+            return -1;
+        }
+        if (f(i, v))
+            return -1;
+    }
+    ++rows;
+    return 1;
+}
+
+QoreListNode* QorePgsqlCopyOut::fetchRows(int maxrows, ExceptionSink* xsink) {
+    ReferenceHolder<QoreListNode> l(new QoreListNode(autoTypeInfo), xsink);
+    while (maxrows < 0 || (int)l->size() < maxrows) {
+        ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+        int rc = readRow([&] (int i, QoreValue v) -> int {
+            h->setKeyValue(cols[i].name.c_str(), v, xsink);
+            return *xsink ? -1 : 0;
+        }, xsink);
+        if (rc < 0)
+            return nullptr;
+        if (!rc)
+            break;
+        l->push(h.release(), xsink);
+    }
+    return l->empty() ? nullptr : l.release();
+}
+
+QoreHashNode* QorePgsqlCopyOut::fetchColumns(int maxrows, ExceptionSink* xsink) {
+    ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+    std::vector<QoreListNode*> lists;
+    for (auto& i : cols) {
+        QoreListNode* l = new QoreListNode(autoTypeInfo);
+        h->setKeyValue(i.name.c_str(), l, xsink);
+        lists.push_back(l);
+    }
+
+    int count = 0;
+    while (maxrows < 0 || count < maxrows) {
+        int rc = readRow([&] (int i, QoreValue v) -> int {
+            return lists[i]->push(v, xsink);
+        }, xsink);
+        if (rc < 0)
+            return nullptr;
+        if (!rc)
+            break;
+        ++count;
+    }
+    return count ? h.release() : nullptr;
+}
+
+void QorePgsqlCopyOut::abort() {
+    if (cbuf) {
+        PQfreemem(cbuf);
+        cbuf = nullptr;
+    }
+    cpos = clen = 0;
+    if (active())
+        conn->abortCopy(nullptr);
+}
+
+int QorePgsqlAsyncQuery::start(const QoreString& str, const QoreListNode* args, ExceptionSink* xsink) {
+    // results are read without pipeline mode, so a deferred BEGIN is sent first
+    if (prepare(str, args, xsink) || conn->checkStream(this, xsink) || conn->flushBegin(xsink))
+        return -1;
+    if (send())
+        return conn->doError(nullptr, xsink);
+    conn->startAsync(this);
+    return 0;
+}
+
+int QorePgsqlAsyncQuery::poll(ExceptionSink* xsink) {
+    if (done)
+        return 1;
+    if (!conn->isAsyncOwner(this)) {
+        xsink->raiseException("DBI:PGSQL:ASYNC-ERROR", "the asynchronous query was discarded by a transaction "
+            "rollback");
+        return -1;
+    }
+
+    PGconn* pc = conn->get();
+    if (!PQconsumeInput(pc)) {
+        // the connection has been lost
+        done = true;
+        conn->doError(nullptr, xsink);
+        conn->abortAsync();
+        return -1;
+    }
+    if (PQisBusy(pc))
+        return 0;
+
+    // read the result and the end of the results so the connection can be used again
+    done = true;
+    res = PQgetResult(pc);
+    while (PGresult* r = PQgetResult(pc))
+        PQclear(r);
+    conn->endAsync();
+    return conn->checkClearResult(false, res, xsink) ? -1 : 1;
+}
+
+int QorePgsqlAsyncQuery::wait(int64 timeout_ms, ExceptionSink* xsink) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true) {
+        int rc = poll(xsink);
+        if (rc)
+            return rc;
+
+        int64 remaining = -1;
+        if (timeout_ms >= 0) {
+            remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline
+                - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0)
+                return 0;
+        }
+        if (conn->waitSocket(false, remaining) < 0) {
+            xsink->raiseErrnoException("DBI:PGSQL:ASYNC-ERROR", errno, "error waiting for the query's result");
+            return -1;
+        }
+    }
+}
+
+QoreValue QorePgsqlAsyncQuery::getResult(int64 timeout_ms, ExceptionSink* xsink) {
+    if (getQueryResult(timeout_ms, xsink))
+        return QoreValue();
+    if (hasResultData())
+        return getOutputHash(xsink);
+    return rowsAffected();
+}
+
+QoreListNode* QorePgsqlAsyncQuery::getRows(int64 timeout_ms, ExceptionSink* xsink) {
+    if (getQueryResult(timeout_ms, xsink))
+        return nullptr;
+    return getOutputList(xsink);
+}
+
+int QorePgsqlAsyncQuery::getQueryResult(int64 timeout_ms, ExceptionSink* xsink) {
+    if (timeout_ms < 0)
+        timeout_ms = conn->getQueryTimeout();
+    int rc = wait(timeout_ms ? timeout_ms : -1, xsink);
+    if (rc < 0)
+        return -1;
+    if (!rc) {
+        // the deadline has passed; cancel the query and wait for the server to end it
+        conn->cancel();
+        ExceptionSink xs;
+        rc = wait(QORE_PG_CANCEL_WAIT_MS, &xs);
+        // the query may have completed before the cancel request was processed
+        if (rc > 0)
+            return 0;
+        // the error raised for the canceled query is replaced by the timeout error
+        xs.clear();
+        if (!rc) {
+            // the connection cannot be used until the query ends
+            done = true;
+            conn->reset();
+        }
+        QorePGConnection::doTimeoutError(timeout_ms, !rc, nullptr, xsink);
+        return -1;
+    }
+    if (!res) {
+        xsink->raiseException("DBI:PGSQL:ASYNC-ERROR", "the asynchronous query failed; no result is available");
+        return -1;
+    }
+    return 0;
+}
+
+void QorePgsqlAsyncQuery::abort() {
+    if (!done && conn->isAsyncOwner(this)) {
+        done = true;
+        conn->abortAsync();
+    }
+}
+
+int QorePGConnection::addBatch(const QoreString* sql, const QoreListNode* args, ExceptionSink* xsink) {
+    std::unique_ptr<QorePgsqlBatchStatement> stmt(new QorePgsqlBatchStatement(this, ds->getQoreEncoding()));
+    if (stmt->prepare(*sql, args, xsink))
+        return -1;
+    batch.push_back(std::move(stmt));
+    return 0;
+}
+
+void QorePGConnection::clearBatch() {
+    batch.clear();
+}
+
+int QorePGConnection::enterPipeline(ExceptionSink* xsink) {
+    if (!PQenterPipelineMode(pc))
+        return doError(nullptr, xsink);
+
+    // the connection is set to non-blocking mode while sending so that results can be read while the output buffer
+    // is flushed; otherwise both sides could block writing with large pipelines
+    PQsetnonblocking(pc, 1);
+    return 0;
+}
+
+int QorePGConnection::flushPipeline() {
+    while (true) {
+        int rc = PQflush(pc);
+        if (rc <= 0)
+            return rc;
+
+        // wait until more data can be sent; input is read in the meantime, as the server may not read more commands
+        // until its results have been read
+        if (waitSocket(true, -1) < 0 || !PQconsumeInput(pc))
+            return -1;
+    }
+}
+
+int QorePGConnection::waitSocket(bool write, int64 timeout_ms) {
+    pollfd fds;
+    fds.fd = PQsocket(pc);
+    fds.events = POLLIN | (write ? POLLOUT : 0);
+    fds.revents = 0;
+    while (true) {
+#if (defined _WIN32 || defined __WIN32__) && ! defined __CYGWIN__
+        int rc = WSAPoll(&fds, 1, timeout_ms < 0 ? -1 : (int)timeout_ms);
+#else
+        int rc = poll(&fds, 1, timeout_ms < 0 ? -1 : (int)timeout_ms);
+        if (rc < 0 && errno == EINTR)
+            continue;
+#endif
+        return rc < 0 ? -1 : (rc ? 1 : 0);
+    }
+}
+
+bool QorePGConnection::syncPipeline() {
+    // all commands sent are executed in a single implicit transaction if no transaction is in progress
+    bool rc = PQstatus(pc) == CONNECTION_OK && PQpipelineSync(pc) && !flushPipeline();
+    PQsetnonblocking(pc, 0);
+    return rc;
+}
+
+PGresult* QorePGConnection::getPipelineResult() {
+    PGresult* rv = PQgetResult(pc);
+    if (rv) {
+        // the results of each command are terminated with a null pointer
+        while (PGresult* t = PQgetResult(pc))
+            PQclear(t);
+    }
+    return rv;
+}
+
+int QorePGConnection::exitPipeline(bool synced) {
+    if (synced) {
+        // the results of each command are terminated with a null pointer; two null pointers in a row mean that no
+        // more results are pending
+        bool end = false;
+        while (true) {
+            PGresult* r = PQgetResult(pc);
+            if (!r) {
+                if (end || PQstatus(pc) != CONNECTION_OK)
+                    break;
+                end = true;
+                continue;
+            }
+            end = false;
+            bool done = PQresultStatus(r) == PGRES_PIPELINE_SYNC;
+            PQclear(r);
+            if (done)
+                break;
+        }
+    }
+    if (PQexitPipelineMode(pc))
+        return 0;
+    printd(5, "QorePGConnection::exitPipeline() this: %p cannot exit pipeline mode: %s\n", this, PQerrorMessage(pc));
+    return -1;
+}
+
+int QorePGConnection::exitPipeline(bool synced, ExceptionSink* xsink) {
+    if (!exitPipeline(synced))
+        return 0;
+    // any transaction in progress is lost with the reset
+    if (!*xsink)
+        doLostConnectionError(wasInTransaction(), nullptr, xsink);
+    reset();
+    return -1;
+}
+
+void QorePGConnection::doBatchError(const char* what, size_t index, size_t count, const char* sql,
+        const PGresult* res, ExceptionSink* xsink) {
+    const char* err = res ? PQresultErrorMessage(res) : PQerrorMessage(pc);
+    const char* e = (!strncmp(err, "ERROR:  ", 8) || !strncmp(err, "FATAL:  ", 8)) ? err + 8 : err;
+    QoreStringNode* desc = new QoreStringNodeMaker("%s %d/%d failed: %s", what, (int)index + 1, (int)count, e);
+    desc->chomp();
+
+    QoreHashNode* arg = getExceptionArg(res, xsink);
+    arg->setKeyValue("index", (int64)index, xsink);
+    arg->setKeyValue("sql", new QoreStringNode(sql, ds->getQoreEncoding()), xsink);
+
+    xsink->raiseExceptionArg("DBI:PGSQL:BATCH-ERROR", arg, desc);
+}
+
+int QorePGConnection::sendPipelineCmd(const char* cmd) {
+    return PQsendQueryParams(pc, cmd, 0, nullptr, nullptr, nullptr, nullptr, 1) && !flushPipeline() ? 0 : -1;
+}
+
+int QorePGConnection::checkPipelineResult(ExceptionSink* xsink) {
+    PGresult* r = getPipelineResult();
+    if (!r) {
+        // the connection has been lost
+        if (!*xsink)
+            doError(nullptr, xsink);
+        return -1;
+    }
+    int rc = 0;
+    if (PQresultStatus(r) != PGRES_COMMAND_OK) {
+        if (!*xsink)
+            doError(r, xsink);
+        rc = -1;
+    }
+    PQclear(r);
+    return rc;
+}
+
+QoreListNode* QorePGConnection::execBatch(bool commit, ExceptionSink* xsink) {
+    // the queued statements are discarded in any case
+    qore_pg_batch_list_t stmts;
+    stmts.swap(batch);
+
+    if (checkStream(nullptr, xsink))
+        return nullptr;
+
+    ReferenceHolder<QoreListNode> rv(new QoreListNode(autoTypeInfo), xsink);
+    if (stmts.empty())
+        return rv.release();
+
+    if (enterPipeline(xsink))
+        return nullptr;
+
+    // a deferred BEGIN is sent as the first command of the pipeline
+    bool begin_sent = false;
+    if (takeBeginPending()) {
+        if (sendPipelineCmd("begin"))
+            doError(nullptr, xsink);
+        else
+            begin_sent = true;
+    }
+
+    size_t count = stmts.size();
+    size_t sent = 0;
+    if (!*xsink) {
+        for (auto& i : stmts) {
+            if (i->send() || flushPipeline()) {
+                doBatchError("batch statement", sent, count, i->getSql(), nullptr, xsink);
+                break;
+            }
+            ++sent;
+        }
+    }
+
+    // the commit is only executed by the server if all statements succeed
+    bool commit_sent = false;
+    if (commit && !*xsink) {
+        if (sendPipelineCmd("commit"))
+            doError(nullptr, xsink);
+        else
+            commit_sent = true;
+    }
 
-    return execIntern(qstr->c_str(), xsink);
-}
+    bool synced = syncPipeline();
+    if (!synced && !*xsink)
+        doError(nullptr, xsink);
 
-int QorePgsqlStatement::exec(const char* cmd, ExceptionSink *xsink) {
-    assert(!nParams && !paramTypes && !paramValues && !paramLengths && !paramFormats);
-    return execIntern(cmd, xsink);
-}
+    if (begin_sent)
+        checkPipelineResult(xsink);
 
-QorePGConnection::QorePGConnection(Datasource* d, const char* str, ExceptionSink *xsink)
-        : ds(d), pc(PQconnectdb(str)), server_tz(currentTZ()),
-            interval_has_day(false),
-            integer_datetimes(false),
-            numeric_support(OPT_NUM_DEFAULT) {
-    if (PQstatus(pc) != CONNECTION_OK) {
-        doError(nullptr, xsink);
-        return;
-    }
+    for (size_t i = 0; i < sent; ++i) {
+        PGresult* r = getPipelineResult();
+        if (!r) {
+            // the connection has been lost
+            if (!*xsink)
+                doError(nullptr, xsink);
+            break;
+        }
 
-    const char* pstr;
-    // get server version to encode/decode binary values properly
-    int server_version = PQserverVersion(pc);
-    //printd(5, "version: %d\n", server_version);
-    interval_has_day = server_version >= 80100 ? true : false;
-    pstr = PQparameterStatus(pc, "integer_datetimes");
+        ExecStatusType rc = PQresultStatus(r);
+        // statements after a failed statement are skipped by the server
+        if (rc == PGRES_PIPELINE_ABORTED || *xsink) {
+            PQclear(r);
+            continue;
+        }
+        if (rc != PGRES_COMMAND_OK && rc != PGRES_TUPLES_OK) {
+            doBatchError("batch statement", i, count, stmts[i]->getSql(), r, xsink);
+            PQclear(r);
+            continue;
+        }
 
-    if (!pstr || !pstr[0]) {
-        // encoding does not matter here; we are only getting an integer
-        QorePgsqlStatement res(this, QCS_DEFAULT);
-        integer_datetimes = res.checkIntegerDateTimes(xsink);
-    } else
-        integer_datetimes = strcmp(pstr, "off");
+        ValueHolder val(stmts[i]->getResult(r, xsink), xsink);
+        if (!*xsink)
+            rv->push(val.release(), xsink);
+    }
+    if (commit_sent && !checkPipelineResult(xsink) && !*xsink)
+        commit_pipelined = true;
+    exitPipeline(synced, xsink);
 
-    if (PQsetClientEncoding(pc, ds->getDBEncoding()))
-        xsink->raiseException("DBI:PGSQL:ENCODING-ERROR", "invalid PostgreSQL encoding '%s'", ds->getDBEncoding());
+    return *xsink ? nullptr : rv.release();
 }
 
-QorePGConnection::~QorePGConnection() {
-    if (pc)
-        PQfinish(pc);
+// returns the channel name quoted as an identifier in the given string; returns 0 for OK, -1 for error
+static int qore_pg_quote_channel(PGconn* pc, const QoreString& channel, const QoreEncoding* enc, std::string& quoted,
+        ExceptionSink* xsink) {
+    TempEncodingHelper name(channel, enc, xsink);
+    if (!name)
+        return -1;
+    char* p = PQescapeIdentifier(pc, name->c_str(), name->size());
+    if (!p) {
+        QoreString msg(PQerrorMessage(pc));
+        msg.chomp();
+        xsink->raiseException("DBI:PGSQL:NOTIFY-ERROR", "invalid channel name '%s': %s", name->c_str(),
+            msg.c_str());
+        return -1;
+    }
+    quoted = p;
+    PQfreemem(p);
+    return 0;
 }
 
-int QorePGConnection::commit(ExceptionSink *xsink) {
-    QorePgsqlStatement res(this, ds->getQoreEncoding());
-    return res.exec("commit", xsink);
-}
+int QorePGConnection::listen(const QoreString& channel, ExceptionSink* xsink) {
+    std::string quoted;
+    if (qore_pg_quote_channel(pc, channel, ds->getQoreEncoding(), quoted, xsink))
+        return -1;
 
-int QorePGConnection::rollback(ExceptionSink *xsink) {
     QorePgsqlStatement res(this, ds->getQoreEncoding());
-    return res.exec("rollback", xsink);
+    res.disableTimeout();
+    std::string cmd = "listen " + quoted;
+    if (res.exec(cmd.c_str(), xsink))
+        return -1;
+    if (std::find(listen_channels.begin(), listen_channels.end(), quoted) == listen_channels.end())
+        listen_channels.push_back(quoted);
+    return 0;
 }
 
-int QorePGConnection::begin_transaction(ExceptionSink *xsink) {
+int QorePGConnection::unlisten(const QoreString* channel, ExceptionSink* xsink) {
+    std::string quoted;
+    if (channel && qore_pg_quote_channel(pc, *channel, ds->getQoreEncoding(), quoted, xsink))
+        return -1;
+
     QorePgsqlStatement res(this, ds->getQoreEncoding());
-    return res.exec("begin", xsink);
+    res.disableTimeout();
+    std::string cmd = "unlisten " + (channel ? quoted : std::string("*"));
+    if (res.exec(cmd.c_str(), xsink))
+        return -1;
+    if (channel) {
+        strvec_t::iterator i = std::find(listen_channels.begin(), listen_channels.end(), quoted);
+        if (i != listen_channels.end())
+            listen_channels.erase(i);
+    } else {
+        listen_channels.clear();
+    }
+    return 0;
 }
 
-QoreListNode* QorePGConnection::selectRows(const QoreString* qstr, const QoreListNode* args, ExceptionSink *xsink) {
-    QorePgsqlStatement res(this, ds->getQoreEncoding());
-    if (res.exec(qstr, args, xsink))
-        return NULL;
+QoreListNode* QorePGConnection::getNotifications(int64 timeout_ms, ExceptionSink* xsink) {
+    if (checkStream(nullptr, xsink))
+        return nullptr;
 
-    return res.getOutputList(xsink);
+    ReferenceHolder<QoreListNode> rv(new QoreListNode(autoTypeInfo), xsink);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms > 0 ? timeout_ms : 0);
+    // notifications received with the results of previous commands are returned without waiting
+    bool read = PQconsumeInput(pc);
+    while (read) {
+        while (PGnotify* n = PQnotifies(pc)) {
+            QoreHashNode* h = new QoreHashNode(autoTypeInfo);
+            h->setKeyValue("channel", new QoreStringNode(n->relname, ds->getQoreEncoding()), xsink);
+            h->setKeyValue("payload", new QoreStringNode(n->extra, ds->getQoreEncoding()), xsink);
+            h->setKeyValue("pid", (int64)n->be_pid, xsink);
+            rv->push(h, xsink);
+            PQfreemem(n);
+        }
+        if (!rv->empty())
+            break;
+
+        int64 remaining = -1;
+        if (timeout_ms >= 0) {
+            remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline
+                - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0)
+                break;
+        }
+        int rc = waitSocket(false, remaining);
+        if (!rc)
+            break;
+        read = rc > 0 && PQconsumeInput(pc);
+    }
+    if (read)
+        return rv.release();
+
+    // the connection has been lost; it is reestablished so that notifications can be received again
+    if (wasInTransaction()) {
+        doLostConnectionError(true, nullptr, xsink);
+        reset();
+    } else if (reset()) {
+        doReconnectError(xsink);
+    } else {
+        xsink->raiseException("DBI:PGSQL:CONNECTION-ERROR", "connection to PostgreSQL database server lost while "
+            "waiting for notifications; the connection has been reestablished and all channels are listened to "
+            "again, but any notifications sent in the meantime have been lost");
+    }
+    return nullptr;
 }
 
-QoreHashNode* QorePGConnection::selectRow(const QoreString* qstr, const QoreListNode* args, ExceptionSink *xsink) {
-    QorePgsqlStatement res(this, ds->getQoreEncoding());
-    if (res.exec(qstr, args, xsink))
-        return NULL;
+std::string QorePGConnection::getStatementName() {
+    QoreStringMaker str("qore_stmt_%u", ++stmt_seq);
+    return str.c_str();
+}
 
-    return res.getSingleRow(xsink);
+std::string QorePGConnection::getCursorName() {
+    QoreStringMaker str("qore_cur_%u", ++stmt_seq);
+    return str.c_str();
 }
 
-QoreValue QorePGConnection::select(const QoreString* qstr, const QoreListNode* args, ExceptionSink *xsink) {
-    QorePgsqlStatement res(this, ds->getQoreEncoding());
-    if (res.exec(qstr, args, xsink))
-        return QoreValue();
+void QorePGConnection::deallocate(qore_pg_prepared_stmt& ps) {
+    if (ps.gen != gen) {
+        ps.gen = 0;
+        return;
+    }
+    ps.gen = 0;
 
-    if (res.hasResultData())
-        return res.getOutputHash(xsink, true);
+    if (PQstatus(pc) != CONNECTION_OK)
+        return;
 
-    return res.rowsAffected();
+    // no commands can be executed until the failed transaction is closed or the active stream or COPY is finished
+    if (isBusy() || PQtransactionStatus(pc) == PQTRANS_INERROR) {
+        pending_dealloc.push_back(ps.name);
+        return;
+    }
+
+    std::string cmd = "deallocate " + ps.name;
+    PGresult* dres = PQexec(pc, cmd.c_str());
+    printd(5, "QorePGConnection::deallocate() '%s': %d\n", ps.name.c_str(), PQresultStatus(dres));
+    PQclear(dres);
 }
 
-QoreValue QorePGConnection::exec(const QoreString* qstr, const QoreListNode* args, ExceptionSink *xsink) {
-    QorePgsqlStatement res(this, ds->getQoreEncoding());
-    if (res.exec(qstr, args, xsink))
-        return QoreValue();
+qore_pg_prepared_stmt* QorePgsqlStatementCache::get(QorePGConnection* conn, const char* sql, int nParams,
+        const Oid* paramTypes) {
+    assert(max_size);
+    // the key is the SQL text followed by the binary parameter types
+    std::string key(sql);
+    key.push_back('\0');
+    if (nParams)
+        key.append((const char*)paramTypes, sizeof(Oid) * nParams);
+
+    lru_map_t::iterator i = lru_map.find(key);
+    if (i != lru_map.end()) {
+        // move the entry to the front of the list
+        lru.splice(lru.begin(), lru, i->second);
+        return &i->second->second;
+    }
 
-    if (res.hasResultData())
-        return res.getOutputHash(xsink);
+    while (lru.size() >= max_size)
+        evict(conn);
 
-    return res.rowsAffected();
+    lru.emplace_front(key, qore_pg_prepared_stmt());
+    lru_map[key] = lru.begin();
+    qore_pg_prepared_stmt* ps = &lru.front().second;
+    ps->name = conn->getStatementName();
+    return ps;
 }
 
-QoreValue QorePGConnection::execRaw(const QoreString* qstr, ExceptionSink *xsink) {
-    QorePgsqlStatement res(this, ds->getQoreEncoding());
-    // convert string to required character encoding or copy
-    std::unique_ptr<QoreString> ccstr(qstr->convertEncoding(ds->getQoreEncoding(), xsink));
-
-    if (res.exec(ccstr->c_str(), xsink))
-        return QoreValue();
-
-    if (res.hasResultData())
-        return res.getOutputHash(xsink);
+void QorePgsqlStatementCache::setMaxSize(QorePGConnection* conn, size_t size) {
+    max_size = size;
+    while (lru.size() > max_size)
+        evict(conn);
+}
 
-    return res.rowsAffected();
+void QorePgsqlStatementCache::evict(QorePGConnection* conn) {
+    assert(!lru.empty());
+    entry_t& e = lru.back();
+    printd(5, "QorePgsqlStatementCache::evict() freeing '%s'\n", e.second.name.c_str());
+    conn->deallocate(e.second);
+    lru_map.erase(e.first);
+    lru.pop_back();
 }
 
-int QorePGConnection::get_server_version() const {
-    return PQserverVersion(pc);
+void QorePGConnection::deallocatePending() {
+    if (pending_dealloc.empty() || isBusy() || PQstatus(pc) != CONNECTION_OK
+        || PQtransactionStatus(pc) == PQTRANS_INERROR)
+        return;
+
+    for (auto& i : pending_dealloc) {
+        std::string cmd = "deallocate " + i;
+        PQclear(PQexec(pc, cmd.c_str()));
+    }
+    pending_dealloc.clear();
 }
 
 // static
@@ -1925,6 +4085,10 @@ int QorePgsqlPreparedStatement::prepare(const QoreString& n_sql, const QoreListN
     do_parse = n_parse;
     parsed = false;
 
+    // the statement is prepared on the server with the first call to exec()
+    ps.name = conn->getStatementName();
+    pstmt = &ps;
+
     return 0;
 }
 
@@ -1940,28 +4104,281 @@ int QorePgsqlPreparedStatement::bind(const QoreListNode &l, ExceptionSink *xsink
     return 0;
 }
 
-int QorePgsqlPreparedStatement::exec(ExceptionSink* xsink) {
+int QorePgsqlPreparedStatement::execStmt(const char* sql, ExceptionSink* xsink) {
+    if (useCursor(sql))
+        return execCursor(sql, xsink);
+
+    int rc = execIntern(sql, xsink, conn->getStreamResults());
+    more = stream = !rc && conn->isStreamOwner(this);
+    return rc;
+}
+
+static bool qore_pg_starts_with_keyword(const char* p, const char* kw) {
+    size_t len = strlen(kw);
+    return !strncasecmp(p, kw, len) && !isalnum((unsigned char)p[len]) && p[len] != '_';
+}
+
+bool QorePgsqlPreparedStatement::useCursor(const char* sql) const {
+    // cursors are only valid within a transaction block; a transaction with a deferred BEGIN is started before the
+    // cursor is declared
+    if (!conn->getCursorFetchRows() || conn->isBusy()
+        || (!conn->isBeginPending() && PQtransactionStatus(conn->get()) != PQTRANS_INTRANS))
+        return false;
+
+    while (isspace((unsigned char)*sql) || *sql == '(')
+        ++sql;
+    return qore_pg_starts_with_keyword(sql, "select") || qore_pg_starts_with_keyword(sql, "values")
+        || qore_pg_starts_with_keyword(sql, "table");
+}
+
+int QorePgsqlPreparedStatement::execCursor(const char* sql, ExceptionSink* xsink) {
+    if (conn->flushBegin(xsink))
+        return -1;
+
+    std::string name = conn->getCursorName();
+    QoreStringMaker cmd("declare %s no scroll cursor for %s", name.c_str(), sql);
+
+    // the cursor is declared with an unnamed statement; the query is planned once for the cursor
+    qore_pg_prepared_stmt* p = pstmt;
+    pstmt = nullptr;
+    int rc = execIntern(cmd.c_str(), xsink);
+    pstmt = p;
+    if (rc)
+        return -1;
+
+    printd(5, "QorePgsqlPreparedStatement::execCursor() this: %p declared cursor '%s'\n", this, name.c_str());
+    cursor = name;
+    more = true;
+    return fetchCursor(xsink);
+}
+
+int QorePgsqlPreparedStatement::fetchCursor(ExceptionSink* xsink) {
+    assert(!cursor.empty());
+    int rows = conn->getCursorFetchRows();
+    if (rows <= 0)
+        rows = 1;
+    QoreStringMaker cmd("fetch forward %d from %s", rows, cursor.c_str());
+
     if (res)
-        QorePgsqlStatement::reset();
+        PQclear(res);
+    res = PQexecParams(conn->get(), cmd.c_str(), 0, nullptr, nullptr, nullptr, nullptr, 1);
+    if (conn->checkClearResult(false, res, xsink)) {
+        more = false;
+        cursor.clear();
+        return -1;
+    }
+
+    // the last rows have been fetched
+    if (PQntuples(res) < rows)
+        closeCursor();
+    return 0;
+}
+
+void QorePgsqlPreparedStatement::closeCursor() {
+    if (cursor.empty())
+        return;
+
+    more = false;
+    // the cursor is closed automatically when the transaction ends
+    if (!conn->isBusy() && PQtransactionStatus(conn->get()) == PQTRANS_INTRANS) {
+        std::string cmd = "close " + cursor;
+        PQclear(PQexec(conn->get(), cmd.c_str()));
+    }
+    cursor.clear();
+}
+
+int QorePgsqlPreparedStatement::getBulkRows(int64& rows, ExceptionSink* xsink) const {
+    rows = 0;
+    if (!targs)
+        return 0;
+
+    bool bulk = false;
+    ConstListIterator li(targs);
+    while (li.next()) {
+        QoreValue v = li.getValue();
+        if (v.getType() != NT_LIST)
+            continue;
+        int64 size = v.get<const QoreListNode>()->size();
+        if (bulk && size != rows) {
+            xsink->raiseException("DBI:PGSQL:BIND-ERROR", "bulk DML error: the list bound to argument %d has %d "
+                "element%s, but a previous list argument has %d element%s; all lists bound must have the same size",
+                (int)li.index() + 1, (int)size, size == 1 ? "" : "s", (int)rows, rows == 1 ? "" : "s");
+            return -1;
+        }
+        bulk = true;
+        rows = size;
+    }
+    if (!bulk)
+        return 0;
+
+    if (tmpl->has_literals) {
+        xsink->raiseException("DBI:PGSQL:BIND-ERROR", "bulk DML error: lists cannot be bound to statements with "
+            "%%d or %%s placeholders");
+        return -1;
+    }
+    return 1;
+}
+
+int QorePgsqlPreparedStatement::bindBulkRow(size_t row, ExceptionSink* xsink) {
+    // free the values bound for the previous row
+    QorePgsqlStatement::reset();
+
+    // list values provide the value for each row; all other values are bound to every row
+    ReferenceHolder<QoreListNode> l(new QoreListNode(autoTypeInfo), xsink);
+    ConstListIterator li(targs);
+    while (li.next()) {
+        QoreValue v = li.getValue();
+        if (v.getType() == NT_LIST)
+            v = v.get<const QoreListNode>()->retrieveEntry(row);
+        l->push(v.refSelf(), xsink);
+    }
+    return bindTemplate(*tmpl, *l, exec_sql, xsink);
+}
+
+int QorePgsqlPreparedStatement::execBulk(size_t rows, ExceptionSink* xsink) {
+    if (conn->checkStream(this, xsink))
+        return -1;
+
+    // reconnect if the connection was lost; commands are not retried when executed in bulk
+    if (PQstatus(conn->get()) != CONNECTION_OK) {
+        if (conn->wasInTransaction()) {
+            QorePGConnection::doLostConnectionError(true, nullptr, xsink);
+            conn->reset();
+            return -1;
+        }
+        if (conn->reset()) {
+            conn->doReconnectError(xsink);
+            return -1;
+        }
+    }
+
+    bulk_affected = 0;
+    if (!rows)
+        return 0;
+
+    const char* cmd = tmpl->sql.c_str();
+    // the statement is prepared with the types of the values in the first row
+    if (bindBulkRow(0, xsink))
+        return -1;
+    PGresult* pres = prepareCmd(cmd);
+    if (pres)
+        return conn->checkClearResult(false, pres, xsink);
+
+    if (conn->enterPipeline(xsink))
+        return -1;
+
+    // a deferred BEGIN is sent as the first command of the pipeline
+    bool begin_sent = false;
+    if (conn->takeBeginPending()) {
+        if (conn->sendPipelineCmd("begin"))
+            conn->doError(nullptr, xsink);
+        else
+            begin_sent = true;
+    }
+
+    PGconn* pc = conn->get();
+    size_t sent = 0;
+    for (size_t i = 0; i < rows && !*xsink; ++i) {
+        if (i && bindBulkRow(i, xsink))
+            break;
+
+        // rows whose value types differ from the prepared statement, for example when integer values need a wider
+        // binary type, are sent with their own types and parsed by the server
+        int ok = pstmt->matches(nParams, paramTypes)
+            ? PQsendQueryPrepared(pc, pstmt->name.c_str(), nParams, paramValues, paramLengths, paramFormats, 1)
+            : PQsendQueryParams(pc, cmd, nParams, paramTypes, paramValues, paramLengths, paramFormats, 1);
+        if (!ok || conn->flushPipeline()) {
+            conn->doBatchError("bulk DML row", i, rows, cmd, nullptr, xsink);
+            break;
+        }
+        ++sent;
+    }
+    QorePgsqlStatement::reset();
+
+    bool synced = conn->syncPipeline();
+    if (!synced && !*xsink)
+        conn->doBatchError("bulk DML row", sent, rows, cmd, nullptr, xsink);
+
+    if (begin_sent)
+        conn->checkPipelineResult(xsink);
+
+    for (size_t i = 0; i < sent; ++i) {
+        PGresult* r = conn->getPipelineResult();
+        if (!r) {
+            // the connection has been lost
+            if (!*xsink)
+                conn->doBatchError("bulk DML row", i, rows, cmd, nullptr, xsink);
+            break;
+        }
+
+        ExecStatusType rc = PQresultStatus(r);
+        // rows after a failed row are skipped by the server
+        if (rc == PGRES_PIPELINE_ABORTED || *xsink) {
+            PQclear(r);
+            continue;
+        }
+        if (rc != PGRES_COMMAND_OK && rc != PGRES_TUPLES_OK) {
+            conn->doBatchError("bulk DML row", i, rows, cmd, r, xsink);
+            PQclear(r);
+            continue;
+        }
+
+        bulk_affected += atoi(PQcmdTuples(r));
+        // the result of the last row is kept as the statement's result
+        if (res)
+            PQclear(res);
+        res = r;
+    }
+    conn->exitPipeline(synced, xsink);
+
+    return *xsink ? -1 : 0;
+}
+
+int QorePgsqlPreparedStatement::exec(ExceptionSink* xsink) {
+    // free any previous result and bound values
+    stopStream();
+    closeCursor();
+    QorePgsqlStatement::reset();
+    crow = -1;
+    bulk_affected = -1;
 
     if (do_parse) {
         if (!parsed) {
-            if (parse(sql, targs, xsink))
+            tmpl = getTemplate(*sql, xsink);
+            if (!tmpl)
                 return -1;
             parsed = true;
-        } else if (targs) {
-            // rebind new arguments
-            ConstListIterator li(targs);
-            while (li.next()) {
-                if (add(li.getValue(), xsink))
-                    return -1;
-            }
         }
+
+        int64 rows;
+        int bulk = getBulkRows(rows, xsink);
+        if (bulk < 0)
+            return -1;
+        // an empty list executes nothing
+        if (bulk)
+            return execBulk(rows, xsink);
+
+        if (!tmpl->has_literals) {
+            if (bindTemplate(*tmpl, targs, exec_sql, xsink))
+                return -1;
+            return execStmt(tmpl->sql.c_str(), xsink);
+        }
+
+        QoreString str(enc);
+        if (bindTemplate(*tmpl, targs, str, xsink))
+            return -1;
+        // literal values are part of the SQL text, so the statement has to be prepared again if they change
+        if (!str.equal(exec_sql)) {
+            conn->deallocate(ps);
+            exec_sql.clear();
+            exec_sql.concat(&str);
+        }
+        return execStmt(exec_sql.c_str(), xsink);
     }
 
     //printd(5, "QorePgsqlPreparedStatement::exec() this: %p do_parse: %d nParams: %d args: %p (len: %d) sql: %s\n", this, do_parse, nParams, targs, targs ? targs->size() : 0, sql->c_str());
 
-    return execIntern(sql->c_str(), xsink);
+    return execStmt(sql->c_str(), xsink);
 }
 
 QoreHashNode* QorePgsqlPreparedStatement::fetchRow(ExceptionSink* xsink) {
@@ -1975,13 +4392,88 @@ QoreHashNode* QorePgsqlPreparedStatement::fetchRow(ExceptionSink* xsink) {
 QoreListNode* QorePgsqlPreparedStatement::fetchRows(int rows, ExceptionSink *xsink) {
     if (crow == -1)
         crow = 0;
-    return getOutputList(xsink, &crow, rows);
+    if (!more)
+        return getOutputList(xsink, &crow, rows);
+
+    ReferenceHolder<QoreListNode> l(new QoreListNode(autoTypeInfo), xsink);
+    while (true) {
+        if (appendOutputList(**l, crow, rows < 0 ? -1 : rows - (int)l->size(), xsink))
+            return nullptr;
+        if (!more || (rows >= 0 && (int)l->size() >= rows))
+            break;
+        if (fetchNextBatch(xsink))
+            return nullptr;
+    }
+    return l.release();
 }
 
 QoreHashNode* QorePgsqlPreparedStatement::fetchColumns(int rows, ExceptionSink *xsink) {
     if (crow == -1)
         crow = 0;
-    return getOutputHash(xsink, false, &crow, rows);
+    if (!more)
+        return getOutputHash(xsink, false, &crow, rows);
+
+    ReferenceHolder<QoreHashNode> h(new QoreHashNode(autoTypeInfo), xsink);
+    std::vector<QoreListNode*> cvec;
+    int count = 0;
+    while (true) {
+        int start = crow;
+        if (appendOutputHash(**h, cvec, crow, rows < 0 ? -1 : rows - count, xsink))
+            return nullptr;
+        count += crow - start;
+        if (!more || (rows >= 0 && count >= rows))
+            break;
+        if (fetchNextBatch(xsink))
+            return nullptr;
+    }
+    return h.release();
+}
+
+QoreHashNode* QorePgsqlPreparedStatement::getOutput(ExceptionSink* xsink) {
+    // an empty bulk DML execution has no result
+    if (!res)
+        return new QoreHashNode(autoTypeInfo);
+    if (!more)
+        return getOutputHash(xsink);
+
+    // return all rows remaining on the server
+    if (crow == -1)
+        crow = 0;
+    return fetchColumns(-1, xsink);
+}
+
+int QorePgsqlPreparedStatement::fetchNextBatch(ExceptionSink* xsink) {
+    assert(more);
+    crow = 0;
+    if (!cursor.empty())
+        return fetchCursor(xsink);
+
+    assert(stream);
+    if (!conn->isStreamOwner(this)) {
+        more = stream = false;
+        xsink->raiseException("DBI:PGSQL:STREAM-ERROR", "the result stream was discarded by a transaction rollback");
+        return -1;
+    }
+
+    PQclear(res);
+    res = PQgetResult(conn->get());
+    if (qore_pg_is_stream_result(PQresultStatus(res)))
+        return 0;
+
+    // the stream is complete or an error occurred
+    more = stream = false;
+    int rc = conn->checkClearResult(false, res, xsink);
+    conn->stopStream(false);
+    return rc;
+}
+
+void QorePgsqlPreparedStatement::stopStream() {
+    if (!stream)
+        return;
+    // cancel the query on the server unless it would invalidate the current transaction
+    if (conn->isStreamOwner(this))
+        conn->stopStream(true);
+    more = stream = false;
 }
 
 QoreHashNode* QorePgsqlPreparedStatement::describe(ExceptionSink *xsink) {
@@ -2124,17 +4616,23 @@ QoreHashNode* QorePgsqlPreparedStatement::describe(ExceptionSink *xsink) {
     return h.release();
 }
 
-bool QorePgsqlPreparedStatement::next() {
-    assert(res);
+bool QorePgsqlPreparedStatement::next(ExceptionSink* xsink) {
+    if (!res)
+        return false;
     ++crow;
     if (crow >= PQntuples(res)) {
-        crow = -1;
-        return false;
+        if (!more || fetchNextBatch(xsink) || !PQntuples(res)) {
+            crow = -1;
+            return false;
+        }
     }
     return true;
 }
 
 void QorePgsqlPreparedStatement::reset(ExceptionSink* xsink) {
+    stopStream();
+    closeCursor();
+
     if (sql) {
         delete sql;
         sql = nullptr;
@@ -2144,6 +4642,8 @@ void QorePgsqlPreparedStatement::reset(ExceptionSink* xsink) {
         do_parse = false;
     if (parsed)
         parsed = false;
+    tmpl.reset();
+    exec_sql.clear();
 
     if (targs) {
         targs->deref(xsink);
@@ -2153,6 +4653,12 @@ void QorePgsqlPreparedStatement::reset(ExceptionSink* xsink) {
     if (crow != -1)
         crow = -1;
 
+    // free the statement on the server
+    if (pstmt) {
+        conn->deallocate(ps);
+        pstmt = nullptr;
+    }
+
     // call parent reset function
     QorePgsqlStatement::reset();
 }
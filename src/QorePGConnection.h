@@ -28,6 +28,14 @@
 
 #include <vector>
 #include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <climits>
+#include <chrono>
+#include <atomic>
+
+#include <qore/OutputStream.h>
 
 typedef std::vector<std::string> strvec_t;
 
@@ -286,31 +294,81 @@ struct qore_pg_numeric_base {
     }
 };
 
+// the sign values of the binary NUMERIC format
+#define QORE_PG_NUMERIC_POS  0x0000
+#define QORE_PG_NUMERIC_NEG  0x4000
+#define QORE_PG_NUMERIC_NAN  0xC000
+#define QORE_PG_NUMERIC_PINF 0xD000
+#define QORE_PG_NUMERIC_NINF 0xF000
+
+// the size of the stack buffer used to decode NUMERIC values; larger values use a heap buffer
+#define QORE_PG_NUMERIC_BUF_SIZE 128
+
+// a NUMERIC value as received from the server; values are decoded from the raw data in network byte order, as the
+// same data may be decoded more than once (issue #4249)
 struct qore_pg_numeric : public qore_pg_numeric_base {
     unsigned short digits[1];
 
-    DLLLOCAL void convertToHost();
     DLLLOCAL QoreValue toOptimal() const;
     DLLLOCAL QoreStringNode* toString() const;
     DLLLOCAL QoreNumberNode* toNumber() const;
-    DLLLOCAL void toStr(QoreString& str) const;
 
-    // must be called on raw data before convertToHost() is called
-    DLLLOCAL size_t rawSize() const;
+    // returns true and assigns the value if it is an integer that fits in an int64
+    DLLLOCAL bool toBigInt(int64& v) const;
+
+    // writes the decimal representation with dscale fractional digits to buf and returns its length; buf must have
+    // room for strSize() bytes
+    DLLLOCAL size_t toStr(char* buf) const;
+
+    // returns the size of the buffer needed by toStr() including the terminating null
+    DLLLOCAL size_t strSize() const;
+
+    // returns the text of NaN and infinite values or nullptr if the value is a number
+    DLLLOCAL const char* getSpecial() const;
 };
 
-#define QORE_MAX_DIGITS 50
-struct qore_pg_numeric_out : public qore_pg_numeric_base {
-    unsigned short digits[QORE_MAX_DIGITS];
-    int size = 0;
+// the number of digit groups stored in qore_pg_numeric_out without a heap allocation; enough for any int64
+#define QORE_PG_NUMERIC_OUT_INLINE 12
+
+// the maximum display scale of a NUMERIC value
+#define QORE_PG_NUMERIC_DSCALE_MAX 0x3FFF
 
-    DLLLOCAL qore_pg_numeric_out(const QoreNumberNode* n);
+// a NUMERIC value in the binary format to send to the server
+class qore_pg_numeric_out {
+public:
+    DLLLOCAL qore_pg_numeric_out() {
+    }
+
+    // encodes an integer directly from its value
+    DLLLOCAL qore_pg_numeric_out(int64 i);
+
+    // encodes a number from its decimal representation; returns 0 for OK, -1 for error
+    DLLLOCAL int set(const QoreNumberNode* n, ExceptionSink* xsink);
+
+    // encodes a number in decimal notation with an optional exponent; str must be null-terminated; returns 0 for OK,
+    // -1 for error
+    DLLLOCAL int set(const char* str, size_t len, ExceptionSink* xsink);
+
+    // returns the header and digit groups in network byte order
+    DLLLOCAL const char* getData() const {
+        return (const char*)(heap ? heap.get() : buf);
+    }
 
     DLLLOCAL int getSize() const {
-        return size;
+        return (4 + ndigits) * sizeof(uint16_t);
     }
 
-    DLLLOCAL void convertToNet();
+private:
+    uint16_t buf[4 + QORE_PG_NUMERIC_OUT_INLINE];
+    // used instead of buf if there are more digit groups than fit in buf
+    std::unique_ptr<uint16_t[]> heap;
+    int ndigits = 0;
+
+    // allocates zeroed storage for the given number of digit groups and returns a pointer to the first group
+    DLLLOCAL uint16_t* alloc(int n);
+
+    // sets the header and converts the digit groups to network byte order
+    DLLLOCAL void finish(int weight, int sign, int dscale);
 };
 
 union qore_pg_time {
@@ -337,11 +395,63 @@ struct qore_pg_time_tz_adt {
 class QorePGConnection;
 typedef QoreValue (*qore_pg_data_func_t)(char *data, int type, int size, QorePGConnection *conn, const QoreEncoding *enc);
 
-typedef std::map<int, qore_pg_data_func_t> qore_pg_data_map_t;
-typedef std::pair<int, qore_pg_data_func_t> qore_pg_array_data_info_t;
-typedef std::map<int, qore_pg_array_data_info_t> qore_pg_array_data_map_t;
 typedef std::map<int, int> qore_pg_array_type_map_t;
 
+// the decoder for a type
+struct qore_pg_decoder {
+    // the decoding function for scalar types
+    qore_pg_data_func_t func = nullptr;
+    // the element type and its decoding function for array types
+    int elem_type = 0;
+    qore_pg_data_func_t elem_func = nullptr;
+};
+
+// the size of the decoder table; the OIDs of all builtin types are below this value
+#define QORE_PG_DECODER_TABLE_SIZE 4096
+
+// decoders indexed directly by type OID, so finding the decoder for a value does not require a search
+class QorePgsqlDecoderTable {
+public:
+    DLLLOCAL void set(int type, qore_pg_data_func_t func) {
+        assert(type > 0 && type < QORE_PG_DECODER_TABLE_SIZE);
+        table[type].func = func;
+    }
+
+    DLLLOCAL void setArray(int type, int elem_type, qore_pg_data_func_t func) {
+        assert(type > 0 && type < QORE_PG_DECODER_TABLE_SIZE);
+        table[type].elem_type = elem_type;
+        table[type].elem_func = func;
+    }
+
+    // returns the decoder for the type or nullptr if the type is not supported
+    DLLLOCAL const qore_pg_decoder* find(int type) const {
+        if ((unsigned)type >= QORE_PG_DECODER_TABLE_SIZE)
+            return nullptr;
+        const qore_pg_decoder* d = &table[type];
+        return d->func || d->elem_func ? d : nullptr;
+    }
+
+private:
+    qore_pg_decoder table[QORE_PG_DECODER_TABLE_SIZE];
+};
+
+// a column of a result with everything needed to return its values; resolved once for each result
+struct qore_pg_column {
+    // the type of the column
+    Oid type;
+    // the decoder for the type or nullptr if the type is not supported
+    const qore_pg_decoder* decoder;
+    // the column name as returned by the server
+    std::string fname;
+    // the unique key for the column in the hashes returned
+    std::string name;
+    // the value type of the list for the column with the "typed-columns" option or nullptr if the type is not
+    // returned in a typed list
+    const QoreTypeInfo* list_type;
+};
+
+typedef std::vector<qore_pg_column> qore_pg_column_plan_t;
+
 static inline void assign_point(Point &p, Point *raw) {
     p.x = MSBf8(raw->x);
     p.y = MSBf8(raw->y);
@@ -354,13 +464,272 @@ static inline void assign_point(Point &p, Point *raw) {
 // return optimal numeric values if options are supported
 #define OPT_NUM_DEFAULT OPT_NUM_OPTIMAL
 
+// a named server-side prepared statement
+struct qore_pg_prepared_stmt {
+    // the name of the statement on the server
+    std::string name;
+    // the parameter types the statement was prepared with
+    std::vector<Oid> types;
+    // the connection generation the statement was prepared in; 0 = not prepared
+    unsigned gen = 0;
+
+    // returns true if the statement was prepared with the given parameter types
+    DLLLOCAL bool matches(int nParams, const Oid* paramTypes) const {
+        if ((int)types.size() != nParams)
+            return false;
+        return !nParams || !memcmp(&types[0], paramTypes, sizeof(Oid) * nParams);
+    }
+};
+
+// the DBI option for the size of the prepared statement cache
+#define PGSQL_OPT_STATEMENT_CACHE_SIZE "statement-cache-size"
+// the DBI option for streaming SQLStatement results
+#define PGSQL_OPT_STREAM_RESULTS "stream-results"
+// the DBI option for the number of rows fetched at a time with server-side cursors for SQLStatement queries
+#define PGSQL_OPT_CURSOR_FETCH_ROWS "cursor-fetch-rows"
+// the DBI option for the maximum time in milliseconds for a command to complete
+#define PGSQL_OPT_QUERY_TIMEOUT "query-timeout"
+// the DBI option for the time in milliseconds that reconnects to a server fail immediately after a failed reconnect
+#define PGSQL_OPT_RECONNECT_BACKOFF "reconnect-backoff"
+// the DBI option for the maximum time in milliseconds to wait for a reconnect to complete
+#define PGSQL_OPT_RECONNECT_TIMEOUT "reconnect-timeout"
+// the DBI option for sending BEGIN with the first command of a transaction
+#define PGSQL_OPT_DEFERRED_BEGIN "deferred-begin"
+// the DBI option for returning columns of fixed-width types in typed lists
+#define PGSQL_OPT_TYPED_COLUMNS "typed-columns"
+
+// the default reconnect backoff in milliseconds
+#define QORE_PG_RECONNECT_BACKOFF_DEFAULT 1000
+// the maximum reconnect backoff in milliseconds; the backoff is doubled with each consecutive failed reconnect
+#define QORE_PG_RECONNECT_BACKOFF_MAX 30000
+
+// the number of rows retrieved with each result when streaming if supported by libpq
+#define QORE_PG_STREAM_CHUNK_ROWS 1000
+
+// the maximum number of bytes written to an output stream with each call when streaming column values
+#define QORE_PG_STREAM_WRITE_SIZE (256 * 1024)
+
+// the savepoint set before a query is streamed in a transaction so that the query can be canceled
+#define QORE_PG_STREAM_SAVEPOINT "qore_pg_stream"
+
+// the time in milliseconds to wait for the server to end a command after a cancel request was sent on timeout
+#define QORE_PG_CANCEL_WAIT_MS 5000
+
+// states for commands executed with a timeout
+// the command was not canceled
+#define QORE_PG_TIMEOUT_NONE 0
+// the command was canceled because the timeout expired
+#define QORE_PG_TIMEOUT_CANCELED 1
+// the server did not respond to the cancel request; the connection must be reset
+#define QORE_PG_TIMEOUT_RESET 2
+
+// returns true if the result holds rows from a query whose results are being streamed
+DLLLOCAL static inline bool qore_pg_is_stream_result(ExecStatusType rc) {
+#ifdef LIBPQ_HAS_CHUNK_MODE
+    if (rc == PGRES_TUPLES_CHUNK)
+        return true;
+#endif
+    return rc == PGRES_SINGLE_TUPLE;
+}
+
+class QorePGConnection;
+class QorePgsqlStatement;
+class QorePgsqlBatchStatement;
+
+// statements queued for pipelined execution
+typedef std::vector<std::unique_ptr<QorePgsqlBatchStatement>> qore_pg_batch_list_t;
+
+// LRU cache of server-side prepared statements for SQL executed through the Datasource API
+class QorePgsqlStatementCache {
+public:
+    // returns the cached statement for the given SQL and parameter types, creating a new entry if necessary
+    DLLLOCAL qore_pg_prepared_stmt* get(QorePGConnection* conn, const char* sql, int nParams, const Oid* paramTypes);
+
+    // sets the maximum number of statements in the cache; 0 = disabled
+    DLLLOCAL void setMaxSize(QorePGConnection* conn, size_t size);
+
+    DLLLOCAL size_t getMaxSize() const {
+        return max_size;
+    }
+
+    // removes all entries without freeing them on the server
+    DLLLOCAL void clear() {
+        lru_map.clear();
+        lru.clear();
+    }
+
+private:
+    typedef std::pair<std::string, qore_pg_prepared_stmt> entry_t;
+    // the most recently used entry is at the front of the list
+    typedef std::list<entry_t> lru_list_t;
+    typedef std::unordered_map<std::string, lru_list_t::iterator> lru_map_t;
+
+    lru_list_t lru;
+    lru_map_t lru_map;
+    size_t max_size = 0;
+
+    // removes the least recently used entry and frees it on the server
+    DLLLOCAL void evict(QorePGConnection* conn);
+};
+
+// failed reconnects for each server, shared between all connections; while the backoff period after a failed
+// reconnect is active, reconnects to the same server fail immediately so that callers are not stalled while the
+// server is unavailable
+class QorePgsqlReconnectBackoff {
+public:
+    // returns true and sets err if reconnects to the server must fail immediately
+    DLLLOCAL bool check(const std::string& conninfo, std::string& err);
+
+    // records a failed reconnect; the backoff period starts at backoff_ms and is doubled with each consecutive
+    // failure; 0 = failures are not recorded
+    DLLLOCAL void failed(const std::string& conninfo, int64 backoff_ms, const char* err);
+
+    // clears any failures recorded for the server
+    DLLLOCAL void succeeded(const std::string& conninfo);
+
+private:
+    struct entry {
+        // the number of consecutive failed reconnects
+        unsigned failures = 0;
+        // reconnects fail immediately until this time
+        std::chrono::steady_clock::time_point retry;
+        // the error message of the last failed reconnect
+        std::string err;
+    };
+    typedef std::unordered_map<std::string, entry> entry_map_t;
+
+    QoreThreadLock m;
+    entry_map_t entry_map;
+};
+
+// the number of hours cached by QorePgsqlLocalTimeCache
+#define QORE_PG_LOCAL_TIME_CACHE_SIZE 16
+
+// converts local times in a time zone to absolute date/time values; the difference between local time and UTC found
+// for an hour is reused for all values in the same hour, so the rules of the time zone are only searched when a value
+// falls in an hour that is not cached
+class QorePgsqlLocalTimeCache {
+public:
+    // returns an absolute date/time value for the given local time in the given zone
+    DLLLOCAL DateTimeNode* make(const AbstractQoreZoneInfo* zone, int64 secs, int us);
+
+private:
+    struct entry {
+        bool valid = false;
+        const AbstractQoreZoneInfo* zone = nullptr;
+        // the local hour as the number of hours from the epoch
+        int64 hour = 0;
+        // the number of seconds to subtract from local times in the hour to get UTC
+        int64 shift = 0;
+        // false if the difference to UTC changes within the hour; then values are converted individually
+        bool fixed = false;
+    };
+
+    entry cache[QORE_PG_LOCAL_TIME_CACHE_SIZE];
+};
+
+// sends cancel requests for a connection from any thread; the handle is shared with PgsqlConnection objects so that
+// it can be used without locking the connection and remains safe to use after the connection has been closed
+class QorePgsqlCancel {
+public:
+    // replaces the cancel object with one for the given connection; nullptr = cancel requests are ignored; must be
+    // called in the thread using the connection
+    DLLLOCAL void set(PGconn* pc);
+
+    // sends a cancel request for the command in progress, if any
+    DLLLOCAL void cancel();
+
+private:
+    // serializes access to pg_cancel; only held to copy or replace the pointer
+    QoreThreadLock m;
+    std::shared_ptr<PGcancel> pg_cancel;
+};
+
+typedef std::shared_ptr<QorePgsqlCancel> qore_pg_cancel_t;
+
 class QorePGConnection {
 protected:
+    DLLLOCAL static QorePgsqlReconnectBackoff reconnect_backoff_map;
+    // the sequence for transaction serials
+    DLLLOCAL static std::atomic<unsigned> trans_seq;
+
     Datasource* ds;
+    // the connection parameters; used to identify the server for reconnect backoffs
+    std::string conninfo;
     PGconn* pc;
     const AbstractQoreZoneInfo* server_tz;
     bool interval_has_day, integer_datetimes;
+    // converts timestamp, date, and time values to absolute date/time values
+    QorePgsqlLocalTimeCache local_time;
+    // the result decoders for the binary date/time format of the server
+    const QorePgsqlDecoderTable* decoders;
     int numeric_support;
+    // incremented every time the connection is reset; server-side prepared statements are only valid in the
+    // generation in which they were prepared
+    unsigned gen = 1;
+    // identifies the current transaction; taken from a process-wide sequence when the connection is created, when
+    // a transaction is started or ended, and when the connection is reset
+    unsigned trans_serial;
+    // sequence for unique server-side prepared statement names
+    unsigned stmt_seq = 0;
+    // prepared statements that could not be deallocated because the current transaction is in an error state
+    strvec_t pending_dealloc;
+    // cache of prepared statements for SQL executed through the Datasource API
+    QorePgsqlStatementCache stmt_cache;
+    // the statement whose results are currently being streamed, if any
+    const QorePgsqlStatement* stream_stmt = nullptr;
+    // true if a savepoint was set before the streamed query was executed in a transaction
+    bool stream_savepoint = false;
+    // the statement executing a COPY on the connection, if any
+    QorePgsqlStatement* copy_stmt = nullptr;
+    // true if copy_stmt is sending data to the server, false if it's receiving data
+    bool copy_in = false;
+    // the asynchronous query in progress on the connection, if any
+    const QorePgsqlStatement* async_stmt = nullptr;
+    // true if SQLStatement results are streamed
+    bool stream_results = false;
+    // the number of rows to fetch at a time with server-side cursors; 0 = cursors are not used
+    int cursor_fetch_rows = 0;
+    // the maximum time in milliseconds for a command to complete; 0 = no limit
+    int64 query_timeout = 0;
+    // the timeout state of the last command executed with a timeout
+    int timeout_state = QORE_PG_TIMEOUT_NONE;
+    // sends cancel requests for the connection; can be used from any thread
+    qore_pg_cancel_t cancel_handle = std::make_shared<QorePgsqlCancel>();
+    // the time in milliseconds that reconnects fail immediately after a failed reconnect; 0 = disabled
+    int64 reconnect_backoff = QORE_PG_RECONNECT_BACKOFF_DEFAULT;
+    // the maximum time in milliseconds to wait for a reconnect; 0 = no limit
+    int64 reconnect_timeout = 0;
+    // the error message of the last failed reconnect
+    std::string reconnect_error;
+    // statements queued for execution with execBatch()
+    qore_pg_batch_list_t batch;
+    // true if BEGIN is sent with the first command of a transaction instead of when the transaction is started
+    bool deferred_begin = false;
+    // true if a transaction has been started but BEGIN has not yet been sent to the server
+    bool begin_pending = false;
+    // true if columns of fixed-width types are returned in typed lists
+    bool typed_columns = false;
+    // true if the transaction was committed in the pipeline of the last batch
+    bool commit_pipelined = false;
+    // the quoted names of the channels listened to on the connection; they are listened to again after a reconnect
+    strvec_t listen_channels;
+
+    DLLLOCAL void deallocatePending();
+
+    // assigns a new transaction serial
+    DLLLOCAL void nextTransaction();
+
+    // reads connection parameters from the server and sets the client encoding; called for every new connection;
+    // initial is true when called for the first connection; returns 0 for OK, -1 for error
+    DLLLOCAL int setup(bool initial, ExceptionSink* xsink);
+
+    // reconnects to the server, waiting at most the reconnect timeout; returns 0 for OK, -1 for error
+    DLLLOCAL int reconnect();
+
+    // executes LISTEN again for all channels after reconnecting, waiting at most until the deadline if timeout is
+    // not 0; returns 0 for OK, -1 for error
+    DLLLOCAL int replayListen(int64 timeout, std::chrono::steady_clock::time_point deadline);
 
 public:
     DLLLOCAL QorePGConnection(Datasource* d, const char *str, ExceptionSink *xsink);
@@ -376,8 +745,221 @@ public:
     DLLLOCAL int begin_transaction(ExceptionSink *xsink);
     DLLLOCAL bool has_interval_day() const { return interval_has_day; }
     DLLLOCAL bool has_integer_datetimes() const { return integer_datetimes; }
+    DLLLOCAL const QorePgsqlDecoderTable& getDecoders() const { return *decoders; }
     DLLLOCAL int get_server_version() const;
 
+    // resets the connection; invalidates all server-side prepared statements; returns 0 for OK, -1 if the
+    // connection could not be reestablished
+    DLLLOCAL int reset();
+
+    // raises a DBI:PGSQL:CONNECTION-ERROR exception after a failed reconnect
+    DLLLOCAL void doReconnectError(ExceptionSink* xsink) const;
+
+    DLLLOCAL unsigned getGeneration() const {
+        return gen;
+    }
+
+    // returns the serial of the current transaction; resources only valid within a transaction must not be used
+    // once it changes
+    DLLLOCAL unsigned getTransactionSerial() const {
+        return trans_serial;
+    }
+
+    // returns a new unique name for a server-side prepared statement
+    DLLLOCAL std::string getStatementName();
+
+    // returns a new unique name for a server-side cursor
+    DLLLOCAL std::string getCursorName();
+
+    // frees the given server-side prepared statement if it's valid in the current connection
+    DLLLOCAL void deallocate(qore_pg_prepared_stmt& ps);
+
+    // returns a cached prepared statement for the given SQL or nullptr if the statement cache is disabled
+    DLLLOCAL qore_pg_prepared_stmt* getCachedStatement(const char* sql, int nParams, const Oid* paramTypes) {
+        return stmt_cache.getMaxSize() ? stmt_cache.get(this, sql, nParams, paramTypes) : nullptr;
+    }
+
+    DLLLOCAL bool getStreamResults() const {
+        return stream_results;
+    }
+
+    DLLLOCAL void startStream(const QorePgsqlStatement* stmt) {
+        assert(!stream_stmt);
+        stream_stmt = stmt;
+    }
+
+    DLLLOCAL bool isStreamOwner(const QorePgsqlStatement* stmt) const {
+        return stream_stmt == stmt;
+    }
+
+    // returns true if the connection is in use by a result stream or a COPY
+    DLLLOCAL bool isBusy() const {
+        return stream_stmt || copy_stmt || async_stmt;
+    }
+
+    DLLLOCAL void startCopy(QorePgsqlStatement* stmt, bool in) {
+        assert(!stream_stmt && !copy_stmt);
+        copy_stmt = stmt;
+        copy_in = in;
+    }
+
+    DLLLOCAL bool isCopyOwner(const QorePgsqlStatement* stmt) const {
+        return copy_stmt == stmt;
+    }
+
+    // reads the results of the COPY and releases the connection; returns 0 for OK, -1 for error
+    DLLLOCAL int endCopy(PGresult*& res, ExceptionSink* xsink);
+
+    // aborts the active COPY; rollback is true if the transaction is being rolled back
+    DLLLOCAL void abortCopy(const char* msg, bool rollback = false);
+
+    DLLLOCAL void startAsync(const QorePgsqlStatement* stmt) {
+        assert(!isBusy());
+        async_stmt = stmt;
+    }
+
+    DLLLOCAL bool isAsyncOwner(const QorePgsqlStatement* stmt) const {
+        return async_stmt == stmt;
+    }
+
+    // releases the connection after the results of the asynchronous query have been read
+    DLLLOCAL void endAsync() {
+        async_stmt = nullptr;
+        deallocatePending();
+    }
+
+    // discards the results of the asynchronous query in progress, canceling it if possible; rollback is true if the
+    // transaction is being rolled back
+    DLLLOCAL void abortAsync(bool rollback = false);
+
+    // sends a cancel request for the command in progress to the server; may be called from any thread
+    DLLLOCAL void cancel() {
+        cancel_handle->cancel();
+    }
+
+    // returns the cancel handle for the connection; requests sent with it after the connection is closed are ignored
+    DLLLOCAL qore_pg_cancel_t getCancelHandle() const {
+        return cancel_handle;
+    }
+
+    // waits for the next result of the command in progress for at most timeout_ms milliseconds; if the timeout
+    // expires, the command is canceled and the timeout state is set if the server ends the command with an error
+    DLLLOCAL PGresult* getTimedResult(int64 timeout_ms);
+
+    // waits until a result can be read without blocking or until the timeout expires; a negative timeout waits
+    // indefinitely; returns 1 if ready, 0 for timeout, -1 for error
+    DLLLOCAL int waitResult(int64 timeout_ms);
+
+    DLLLOCAL int64 getQueryTimeout() const {
+        return query_timeout;
+    }
+
+    DLLLOCAL int getTimeoutState() const {
+        return timeout_state;
+    }
+
+    // waits until the socket is readable, or also writable if write is true, or until the timeout expires; a
+    // negative timeout waits indefinitely; returns 1 if ready, 0 for timeout, -1 for error
+    DLLLOCAL int waitSocket(bool write, int64 timeout_ms);
+
+    DLLLOCAL int getCursorFetchRows() const {
+        return cursor_fetch_rows;
+    }
+
+    // returns -1 and raises an exception if another statement is streaming results or executing a COPY on the
+    // connection
+    DLLLOCAL int checkStream(const QorePgsqlStatement* stmt, ExceptionSink* xsink);
+
+    // reads and discards any remaining results of the active stream; if cancel is true, the query is also
+    // canceled on the server if this does not invalidate the current transaction
+    DLLLOCAL void stopStream(bool cancel);
+
+    // sets a savepoint before a query is streamed if a transaction is in progress, so that the query can be
+    // canceled without invalidating the transaction; returns nullptr for OK or the error result
+    DLLLOCAL PGresult* setStreamSavepoint();
+
+    // releases the savepoint set for a streamed query, if any; if rollback is true, the transaction is first rolled
+    // back to the savepoint
+    DLLLOCAL void releaseStreamSavepoint(bool rollback);
+
+    // forgets the savepoint set for a streamed query without releasing it
+    DLLLOCAL void discardStreamSavepoint() {
+        stream_savepoint = false;
+    }
+
+    // enters pipeline mode; returns 0 for OK, -1 for error
+    DLLLOCAL int enterPipeline(ExceptionSink* xsink);
+
+    // flushes the output buffer in pipeline mode while reading any input; returns 0 for OK, -1 for error
+    DLLLOCAL int flushPipeline();
+
+    // sends a sync after the last command in the pipeline; returns true if the sync was sent
+    DLLLOCAL bool syncPipeline();
+
+    // returns the result of the next command in the pipeline; returns nullptr if the connection was lost
+    DLLLOCAL PGresult* getPipelineResult();
+
+    // reads all results up to the sync result if the sync was sent and exits pipeline mode; returns 0 for OK, -1 if
+    // pipeline mode could not be exited because results are still pending, in which case the connection cannot be
+    // used until it is reset
+    DLLLOCAL int exitPipeline(bool synced);
+
+    // exits pipeline mode as above; if results are still pending, the connection is reset and an exception is raised
+    // unless one has already been raised; returns 0 for OK, -1 if the connection was reset
+    DLLLOCAL int exitPipeline(bool synced, ExceptionSink* xsink);
+
+    // raises a DBI:PGSQL:BATCH-ERROR exception for a command executed in pipeline mode
+    DLLLOCAL void doBatchError(const char* what, size_t index, size_t count, const char* sql, const PGresult* res,
+            ExceptionSink* xsink);
+
+    // queues a statement for execution with execBatch(); returns 0 for OK, -1 for error
+    DLLLOCAL int addBatch(const QoreString* sql, const QoreListNode* args, ExceptionSink* xsink);
+
+    // executes all queued statements in pipeline mode and returns a list of their results; if commit is true, the
+    // transaction is committed in the same pipeline
+    DLLLOCAL QoreListNode* execBatch(bool commit, ExceptionSink* xsink);
+
+    // sends a command in pipeline mode; returns 0 for OK, -1 for error
+    DLLLOCAL int sendPipelineCmd(const char* cmd);
+
+    // reads the result of a command without result rows sent in pipeline mode; returns 0 for OK, -1 for error
+    DLLLOCAL int checkPipelineResult(ExceptionSink* xsink);
+
+    DLLLOCAL bool isBeginPending() const {
+        return begin_pending;
+    }
+
+    // returns true and clears the flag if BEGIN has to be sent with the next command
+    DLLLOCAL bool takeBeginPending() {
+        if (!begin_pending)
+            return false;
+        begin_pending = false;
+        return true;
+    }
+
+    // sends a deferred BEGIN without a command; returns the result if BEGIN failed, otherwise nullptr
+    DLLLOCAL PGresult* execBegin();
+
+    // sends a deferred BEGIN before a command that cannot include it; returns 0 for OK, -1 for error
+    DLLLOCAL int flushBegin(ExceptionSink* xsink);
+
+    // listens for notifications on the given channel; returns 0 for OK, -1 for error
+    DLLLOCAL int listen(const QoreString& channel, ExceptionSink* xsink);
+
+    // stops listening on the given channel, or on all channels if channel is nullptr; returns 0 for OK, -1 for error
+    DLLLOCAL int unlisten(const QoreString* channel, ExceptionSink* xsink);
+
+    // returns the notifications received on the connection, waiting at most timeout_ms milliseconds for the first
+    // notification; a negative timeout waits indefinitely; returns an empty list if the timeout expires
+    DLLLOCAL QoreListNode* getNotifications(int64 timeout_ms, ExceptionSink* xsink);
+
+    DLLLOCAL size_t getBatchSize() const {
+        return batch.size();
+    }
+
+    // discards all queued statements
+    DLLLOCAL void clearBatch();
+
     DLLLOCAL int setOption(const char* opt, const QoreValue val, ExceptionSink* xsink) {
         if (!strcasecmp(opt, DBI_OPT_NUMBER_OPT)) {
             numeric_support = OPT_NUM_OPTIMAL;
@@ -391,6 +973,44 @@ public:
             numeric_support = OPT_NUM_NUMERIC;
             return 0;
         }
+        if (!strcasecmp(opt, PGSQL_OPT_STATEMENT_CACHE_SIZE)) {
+            int64 size = val.getAsBigInt();
+            if (size < 0) {
+                xsink->raiseException("DBI:PGSQL:OPTION-ERROR", "the '%s' option requires a non-negative integer "
+                    "value; got " QLLD, PGSQL_OPT_STATEMENT_CACHE_SIZE, size);
+                return -1;
+            }
+            stmt_cache.setMaxSize(this, size);
+            return 0;
+        }
+        if (!strcasecmp(opt, PGSQL_OPT_STREAM_RESULTS)) {
+            stream_results = val.getAsBool();
+            return 0;
+        }
+        if (!strcasecmp(opt, PGSQL_OPT_CURSOR_FETCH_ROWS)) {
+            int64 rows = val.getAsBigInt();
+            if (rows < 0 || rows > INT_MAX) {
+                xsink->raiseException("DBI:PGSQL:OPTION-ERROR", "the '%s' option requires a non-negative integer "
+                    "value; got " QLLD, PGSQL_OPT_CURSOR_FETCH_ROWS, rows);
+                return -1;
+            }
+            cursor_fetch_rows = rows;
+            return 0;
+        }
+        if (!strcasecmp(opt, PGSQL_OPT_QUERY_TIMEOUT))
+            return setMsOption(opt, val, query_timeout, xsink);
+        if (!strcasecmp(opt, PGSQL_OPT_RECONNECT_BACKOFF))
+            return setMsOption(opt, val, reconnect_backoff, xsink);
+        if (!strcasecmp(opt, PGSQL_OPT_RECONNECT_TIMEOUT))
+            return setMsOption(opt, val, reconnect_timeout, xsink);
+        if (!strcasecmp(opt, PGSQL_OPT_DEFERRED_BEGIN)) {
+            deferred_begin = val.getAsBool();
+            return 0;
+        }
+        if (!strcasecmp(opt, PGSQL_OPT_TYPED_COLUMNS)) {
+            typed_columns = val.getAsBool();
+            return 0;
+        }
         assert(!strcasecmp(opt, DBI_OPT_TIMEZONE));
         assert(val.getType() == NT_STRING);
         const QoreStringNode* str =
@@ -413,19 +1033,62 @@ public:
         if (!strcasecmp(opt, DBI_OPT_NUMBER_NUMERIC))
             return numeric_support == OPT_NUM_NUMERIC;
 
+        if (!strcasecmp(opt, PGSQL_OPT_STATEMENT_CACHE_SIZE))
+            return (int64)stmt_cache.getMaxSize();
+
+        if (!strcasecmp(opt, PGSQL_OPT_STREAM_RESULTS))
+            return stream_results;
+
+        if (!strcasecmp(opt, PGSQL_OPT_CURSOR_FETCH_ROWS))
+            return (int64)cursor_fetch_rows;
+
+        if (!strcasecmp(opt, PGSQL_OPT_QUERY_TIMEOUT))
+            return query_timeout;
+
+        if (!strcasecmp(opt, PGSQL_OPT_RECONNECT_BACKOFF))
+            return reconnect_backoff;
+
+        if (!strcasecmp(opt, PGSQL_OPT_RECONNECT_TIMEOUT))
+            return reconnect_timeout;
+
+        if (!strcasecmp(opt, PGSQL_OPT_DEFERRED_BEGIN))
+            return deferred_begin;
+
+        if (!strcasecmp(opt, PGSQL_OPT_TYPED_COLUMNS))
+            return typed_columns;
+
         assert(!strcasecmp(opt, DBI_OPT_TIMEZONE));
         return new QoreStringNode(tz_get_region_name(server_tz));
     }
 
+    // sets an option given in milliseconds; returns 0 for OK, -1 for error
+    DLLLOCAL static int setMsOption(const char* opt, const QoreValue val, int64& ms, ExceptionSink* xsink) {
+        int64 v = val.getAsBigInt();
+        if (v < 0) {
+            xsink->raiseException("DBI:PGSQL:OPTION-ERROR", "the '%s' option requires a non-negative integer "
+                "value; got " QLLD, opt, v);
+            return -1;
+        }
+        ms = v;
+        return 0;
+    }
+
     DLLLOCAL int getNumeric() const { return numeric_support; }
 
+    DLLLOCAL bool getTypedColumns() const { return typed_columns; }
+
     DLLLOCAL const AbstractQoreZoneInfo* getTZ() const {
         return server_tz;
     }
 
+    // returns an absolute date/time value for a local time in the given zone
+    DLLLOCAL DateTimeNode* makeLocalTime(const AbstractQoreZoneInfo* zone, int64 secs, int us) {
+        return local_time.make(zone, secs, us);
+    }
+
     DLLLOCAL int checkResult(PGresult* res, ExceptionSink* xsink) {
         ExecStatusType rc = PQresultStatus(res);
-        if (rc != PGRES_COMMAND_OK && rc != PGRES_TUPLES_OK) {
+        if (rc != PGRES_COMMAND_OK && rc != PGRES_TUPLES_OK && !qore_pg_is_stream_result(rc)) {
             //printd(5, "PQresultStatus() returned %d\n", rc);
             return doError(res, xsink);
         }
@@ -452,6 +1115,9 @@ public:
     }
 
     DLLLOCAL int doError(PGresult *res, ExceptionSink *xsink) {
+        if (timeout_state != QORE_PG_TIMEOUT_NONE)
+            return doTimeoutError(res, xsink);
+
         const char* err = PQerrorMessage(pc);
         const char* e = (!strncmp(err, "ERROR:  ", 8) || !strncmp(err, "FATAL:  ", 8)) ? err + 8 : err;
         QoreStringNode* desc = new QoreStringNode(e);
@@ -478,6 +1144,14 @@ public:
     DLLLOCAL static QoreHashNode* getExceptionArg(const PGresult *res, ExceptionSink *xsink);
 
     DLLLOCAL static void doLostConnectionError(bool in_trans, const PGresult *res, ExceptionSink* xsink);
+
+    // raises a DBI:PGSQL:TIMEOUT exception for a command canceled because the query timeout expired and clears the
+    // timeout state
+    DLLLOCAL int doTimeoutError(const PGresult* res, ExceptionSink* xsink);
+
+    // raises a DBI:PGSQL:TIMEOUT exception; was_reset is true if the connection had to be reset
+    DLLLOCAL static void doTimeoutError(int64 timeout_ms, bool was_reset, const PGresult* res,
+            ExceptionSink* xsink);
 };
 
 #ifdef HAVE_ARPA_INET_H
@@ -520,10 +1194,58 @@ public:
     }
 };
 
+// SQL with Qore DBI placeholders processed for PostgreSQL; shared between all connections
+struct QorePgsqlSqlTemplate {
+    // a placeholder in the original SQL; one argument is consumed for each placeholder
+    struct placeholder {
+        // 'v' for a bind by value, 'd' for a numeric literal, 's' for a string literal
+        char kind;
+        // for 'd' and 's': the byte offset in the rewritten SQL where the literal value is inserted
+        size_t offset;
+    };
+
+    // the rewritten SQL; '%v' placeholders are replaced with '$<n>', '%d' and '%s' are removed
+    std::string sql;
+    // placeholders in the order they appear in the SQL
+    std::vector<placeholder> placeholders;
+    // true if the SQL has any '%d' or '%s' placeholders that have to be substituted in the SQL text
+    bool has_literals = false;
+};
+
+typedef std::shared_ptr<const QorePgsqlSqlTemplate> qore_pg_sql_template_t;
+
+// module-wide LRU cache of SQL templates keyed by the SQL text
+class QorePgsqlSqlTemplateCache {
+public:
+    // returns the cached template or an empty pointer if not found
+    DLLLOCAL qore_pg_sql_template_t get(const std::string& key);
+
+    // adds the given template to the cache
+    DLLLOCAL void add(const std::string& key, const qore_pg_sql_template_t& tmpl);
+
+private:
+    typedef std::pair<std::string, qore_pg_sql_template_t> entry_t;
+    // the most recently used entry is at the front of the list
+    typedef std::list<entry_t> lru_list_t;
+    typedef std::unordered_map<std::string, lru_list_t::iterator> lru_map_t;
+
+    QoreThreadLock m;
+    lru_list_t lru;
+    lru_map_t lru_map;
+};
+
+// the maximum number of entries in the SQL template cache
+#define QORE_PG_SQL_TEMPLATE_CACHE_SIZE 1024
+// the maximum size in bytes of SQL cached in the SQL template cache; longer SQL, typically generated with inline
+// values, is processed every time, so the cache uses at most a few megabytes
+#define QORE_PG_SQL_TEMPLATE_MAX_SQL 8192
+
 class QorePgsqlStatement {
 protected:
-    DLLLOCAL static qore_pg_data_map_t data_map;
-    DLLLOCAL static qore_pg_array_data_map_t array_data_map;
+    // result decoders for each combination of integer or floating-point date/time values and intervals with or
+    // without days
+    DLLLOCAL static QorePgsqlDecoderTable decoder_tables[4];
+    DLLLOCAL static QorePgsqlSqlTemplateCache template_cache;
 
     PGresult* res;
     int nParams, allocated;
@@ -534,15 +1256,58 @@ protected:
     parambuf_list_t parambuf_list;
     QorePGConnection *conn;
     const QoreEncoding *enc;
-
-    DLLLOCAL QoreValue getValue(int row, int col, ExceptionSink *xsink);
+    // the server-side prepared statement to execute, if any
+    qore_pg_prepared_stmt* pstmt = nullptr;
+    // true if pstmt is owned by the connection's statement cache
+    bool pstmt_cached = false;
+    // false if the command must not be canceled when the query timeout expires
+    bool use_timeout = true;
+    // true if streamed results are retrieved one row at a time
+    bool single_row = false;
+    // the columns of the current result and the result they were resolved for
+    qore_pg_column_plan_t columns;
+    const PGresult* columns_res = nullptr;
+
+    // returns the columns of the current result; they are only resolved again if the columns differ from those of
+    // the last result, so the rows of a result stream or cursor share the same plan
+    DLLLOCAL const qore_pg_column_plan_t& getColumns();
+    DLLLOCAL QoreValue getValue(int row, int col, const qore_pg_column& c, ExceptionSink *xsink);
+    // decodes a non-NULL value in the binary format of the given column
+    DLLLOCAL QoreValue decodeValue(char* data, const qore_pg_column& c, int len, ExceptionSink* xsink);
     // returns 0 for OK, -1 for error
     DLLLOCAL int parse(QoreString *str, const QoreListNode *args, ExceptionSink *xsink);
+    // binds the arguments to the template and writes the SQL to execute to str; returns 0 for OK, -1 for error
+    DLLLOCAL int bindTemplate(const QorePgsqlSqlTemplate& tmpl, const QoreListNode* args, QoreString& str,
+            ExceptionSink* xsink);
+    // returns the template for the given SQL; returns an empty pointer if an exception was raised
+    DLLLOCAL static qore_pg_sql_template_t getTemplate(const QoreString& str, ExceptionSink* xsink);
+    // processes placeholders in the given SQL; returns an empty pointer if an exception was raised
+    DLLLOCAL static qore_pg_sql_template_t compileTemplate(const QoreString& str, ExceptionSink* xsink);
     DLLLOCAL int add(QoreValue v, ExceptionSink *xsink);
     DLLLOCAL QoreListNode* getArray(int type, qore_pg_data_func_t func, char *&array_data, int current, int ndim, int dim[]);
     DLLLOCAL void reset();
     DLLLOCAL QoreHashNode* getSingleRowIntern(ExceptionSink* xsink, int row = 0);
-    DLLLOCAL int execIntern(const char* sql, ExceptionSink* xsink);
+    // if stream is true, only the first rows of the result are retrieved if the command returns rows
+    DLLLOCAL int execIntern(const char* sql, ExceptionSink* xsink, bool stream = false);
+    // sends the command to the server and returns the result; the result may also represent an error
+    DLLLOCAL PGresult* execCmd(const char* sql, bool stream = false);
+    // prepares pstmt on the server if necessary; returns nullptr for OK or the error result
+    DLLLOCAL PGresult* prepareCmd(const char* sql);
+    // sends a deferred BEGIN and the command in a single pipeline and returns the result of the command, or the
+    // result of BEGIN if it failed
+    DLLLOCAL PGresult* execCmdWithBegin(const char* sql);
+    // returns the first result of a command sent asynchronously, waiting at most timeout_ms milliseconds if
+    // timeout_ms is not 0, and starts streaming if stream is true and the command returns rows
+    DLLLOCAL PGresult* getResult(int sent, bool stream, int64 timeout_ms);
+    // appends rows from the current result to the hash of column lists; returns 0 for OK, -1 for error
+    DLLLOCAL int appendOutputHash(QoreHashNode& h, std::vector<QoreListNode*>& cvec, int& i, int maxrows,
+            ExceptionSink* xsink);
+    // appends the values of a column in the given rows of the current result to the list in a single pass;
+    // returns 0 for OK, -1 for error
+    DLLLOCAL int appendColumn(QoreListNode& l, int col, const qore_pg_column& c, int start, int end,
+            ExceptionSink* xsink);
+    // appends rows from the current result to the list of row hashes; returns 0 for OK, -1 for error
+    DLLLOCAL int appendOutputList(QoreListNode& l, int& i, int maxrows, ExceptionSink* xsink);
 
 public:
     DLLLOCAL static qore_pg_array_type_map_t array_type_map;
@@ -557,7 +1322,19 @@ public:
     // returns 0 for OK, -1 for error
     DLLLOCAL int exec(const char* cmd, ExceptionSink* xsink);
 
-    DLLLOCAL void setupColumns(QoreHashNode& h, strvec_t& cvec, int num_columns);
+    // executes a query returning a single bytea or text column and writes the value of each row to the stream; rows
+    // are retrieved one at a time and values are written directly from the result; returns the number of rows or
+    // -1 for error
+    DLLLOCAL int64 execToStream(const QoreString* str, const QoreListNode* args, OutputStream* os,
+            ExceptionSink* xsink);
+
+    // the command is not subject to the query timeout; used for transaction control commands
+    DLLLOCAL void disableTimeout() {
+        use_timeout = false;
+    }
+
+    // adds an empty list for each column of the current result to the hash
+    DLLLOCAL void setupColumns(QoreHashNode& h, std::vector<QoreListNode*>& cvec);
     DLLLOCAL QoreHashNode* getOutputHash(ExceptionSink* xsink, bool cols = false, int* start = 0, int maxrows = -1);
     DLLLOCAL QoreListNode* getOutputList(ExceptionSink* xsink, int* start = 0, int maxrows = -1);
 
@@ -566,6 +1343,9 @@ public:
     DLLLOCAL bool hasResultData();
     DLLLOCAL bool checkIntegerDateTimes(ExceptionSink *xsink);
 
+    // returns the decoders for the given binary date/time format
+    DLLLOCAL static const QorePgsqlDecoderTable& getDecoderTable(bool integer_datetimes, bool interval_day);
+
     // static functions
     DLLLOCAL static void static_init();
 };
@@ -578,11 +1358,45 @@ protected:
     int crow;
     bool do_parse;
     bool parsed;
+    // the server-side prepared statement
+    qore_pg_prepared_stmt ps;
+    // the parsed SQL
+    qore_pg_sql_template_t tmpl;
+    // the SQL last executed when parsing
+    QoreString exec_sql;
+    // true if more rows are being streamed from the server
+    bool stream = false;
+    // the name of the open server-side cursor, if any
+    std::string cursor;
+    // true if more rows can be retrieved from the server after the current result
+    bool more = false;
+    // the total number of rows affected by the last bulk DML execution; -1 = not executed in bulk
+    int bulk_affected = -1;
 
     DLLLOCAL int prepareIntern(const QoreListNode* args, ExceptionSink* xsink);
+    DLLLOCAL int execStmt(const char* sql, ExceptionSink* xsink);
+    // replaces the current result with the next rows from the server; returns 0 for OK, -1 for error
+    DLLLOCAL int fetchNextBatch(ExceptionSink* xsink);
+    // discards the rest of an active result stream
+    DLLLOCAL void stopStream();
+    // returns true if the query should be executed with a server-side cursor
+    DLLLOCAL bool useCursor(const char* sql) const;
+    // declares a cursor for the query and fetches the first rows; returns 0 for OK, -1 for error
+    DLLLOCAL int execCursor(const char* sql, ExceptionSink* xsink);
+    // fetches the next rows from the cursor; returns 0 for OK, -1 for error
+    DLLLOCAL int fetchCursor(ExceptionSink* xsink);
+    // closes the server-side cursor, if any
+    DLLLOCAL void closeCursor();
+    // sets the number of rows to execute in bulk; returns 1 if any bound value is a list, 0 if not, or -1 for error
+    DLLLOCAL int getBulkRows(int64& rows, ExceptionSink* xsink) const;
+    // binds the values of the given row position for bulk execution; returns 0 for OK, -1 for error
+    DLLLOCAL int bindBulkRow(size_t row, ExceptionSink* xsink);
+    // executes the statement once for each row position in pipeline mode; returns 0 for OK, -1 for error
+    DLLLOCAL int execBulk(size_t rows, ExceptionSink* xsink);
 
 public:
-    DLLLOCAL QorePgsqlPreparedStatement(Datasource* ds) : QorePgsqlStatement(ds), sql(0), targs(0), crow(-1), do_parse(false), parsed(false) {
+    DLLLOCAL QorePgsqlPreparedStatement(Datasource* ds) : QorePgsqlStatement(ds), sql(0), targs(0), crow(-1), do_parse(false), parsed(false),
+            exec_sql(ds->getQoreEncoding()) {
     }
 
     DLLLOCAL ~QorePgsqlPreparedStatement() {
@@ -597,11 +1411,205 @@ public:
     DLLLOCAL QoreListNode* fetchRows(int rows, ExceptionSink* xsink);
     DLLLOCAL QoreHashNode* fetchColumns(int rows, ExceptionSink* xsink);
     DLLLOCAL QoreHashNode* describe(ExceptionSink* xsink);
-    DLLLOCAL bool next();
+    DLLLOCAL QoreHashNode* getOutput(ExceptionSink* xsink);
+    DLLLOCAL bool next(ExceptionSink* xsink);
+
+    // returns the total for bulk DML executions
+    DLLLOCAL int rowsAffected() {
+        return bulk_affected >= 0 ? bulk_affected : QorePgsqlStatement::rowsAffected();
+    }
 
     DLLLOCAL void reset(ExceptionSink *xsink);
 };
 
+// a statement queued for pipelined execution
+class QorePgsqlBatchStatement : public QorePgsqlStatement {
+public:
+    DLLLOCAL QorePgsqlBatchStatement(QorePGConnection* r_conn, const QoreEncoding* r_enc)
+            : QorePgsqlStatement(r_conn, r_enc) {
+    }
+
+    // processes placeholders and binds the arguments; returns 0 for OK, -1 for error
+    DLLLOCAL int prepare(const QoreString& str, const QoreListNode* args, ExceptionSink* xsink);
+
+    // sends the statement to the server; returns 0 for OK, -1 for error
+    DLLLOCAL int send();
+
+    // takes ownership of the result and returns the statement's result value
+    DLLLOCAL QoreValue getResult(PGresult* r, ExceptionSink* xsink);
+
+    DLLLOCAL const char* getSql() const {
+        return sql->c_str();
+    }
+
+protected:
+    std::unique_ptr<QoreString> sql;
+};
+
+// a query executed asynchronously; the connection can be used by the thread for other work while the server executes
+// the query
+class QorePgsqlAsyncQuery : public QorePgsqlBatchStatement {
+public:
+    DLLLOCAL QorePgsqlAsyncQuery(QorePGConnection* r_conn, const QoreEncoding* r_enc)
+            : QorePgsqlBatchStatement(r_conn, r_enc) {
+    }
+
+    // processes placeholders, binds the arguments, and sends the query; returns 0 for OK, -1 for error
+    DLLLOCAL int start(const QoreString& str, const QoreListNode* args, ExceptionSink* xsink);
+
+    // reads any input from the server without blocking; returns 1 if the result is available, 0 if not, -1 for error
+    DLLLOCAL int poll(ExceptionSink* xsink);
+
+    // waits for the result; a negative timeout waits indefinitely; returns 1 if the result is available, 0 for
+    // timeout, -1 for error
+    DLLLOCAL int wait(int64 timeout_ms, ExceptionSink* xsink);
+
+    // waits for the result and returns it as a hash of column lists or the number of rows affected; see
+    // getQueryResult() for the timeout
+    DLLLOCAL QoreValue getResult(int64 timeout_ms, ExceptionSink* xsink);
+
+    // waits for the result and returns it as a list of row hashes; see getQueryResult() for the timeout
+    DLLLOCAL QoreListNode* getRows(int64 timeout_ms, ExceptionSink* xsink);
+
+    // discards the query's result, canceling the query if possible
+    DLLLOCAL void abort();
+
+    DLLLOCAL QorePGConnection* getConnection() const {
+        return conn;
+    }
+
+protected:
+    // true once the result has been read
+    bool done = false;
+
+    // waits for the result; if the timeout expires, the query is canceled and a DBI:PGSQL:TIMEOUT exception is
+    // raised; a negative timeout uses the connection's query timeout, and 0 waits indefinitely; returns 0 for OK, -1
+    // for error
+    DLLLOCAL int getQueryResult(int64 timeout_ms, ExceptionSink* xsink);
+};
+
+// the size of the buffer for data sent to the server with COPY FROM STDIN
+#define QORE_PG_COPY_BUFFER_SIZE (256 * 1024)
+
+// encodes rows in the binary COPY format and sends them to the server with COPY FROM STDIN
+class QorePgsqlCopyIn : public QorePgsqlStatement {
+public:
+    DLLLOCAL QorePgsqlCopyIn(QorePGConnection* r_conn, const QoreEncoding* r_enc)
+            : QorePgsqlStatement(r_conn, r_enc) {
+    }
+
+    // starts the COPY for the given table and columns (all columns if empty); returns 0 for OK, -1 for error
+    DLLLOCAL int start(const QoreString& table, const QoreListNode* columns, ExceptionSink* xsink);
+
+    // encodes a row given as a list of values in column order; returns 0 for OK, -1 for error
+    DLLLOCAL int addRow(const QoreListNode& row, ExceptionSink* xsink);
+
+    // encodes a row given as a hash of column values; returns 0 for OK, -1 for error
+    DLLLOCAL int addRow(const QoreHashNode& row, ExceptionSink* xsink);
+
+    // sends any remaining data and ends the COPY; returns the number of rows copied or -1 for error
+    DLLLOCAL int64 finish(ExceptionSink* xsink);
+
+    // aborts the COPY on the server with the given error message
+    DLLLOCAL void abort(const char* msg);
+
+    // returns true if the COPY is in progress
+    DLLLOCAL bool active() const {
+        return conn->isCopyOwner(this);
+    }
+
+    DLLLOCAL int64 getRowCount() const {
+        return rows;
+    }
+
+    DLLLOCAL QorePGConnection* getConnection() const {
+        return conn;
+    }
+
+protected:
+    // the names and types of the target columns
+    strvec_t names;
+    std::vector<Oid> types;
+    // data not yet sent to the server
+    std::string buf;
+    // the number of rows added
+    int64 rows = 0;
+
+    // returns -1 and raises an exception if the COPY is not in progress
+    DLLLOCAL int checkActive(ExceptionSink* xsink) const;
+
+    // encodes a single value for the given column; returns 0 for OK, -1 for error
+    DLLLOCAL int addValue(size_t col, QoreValue v, ExceptionSink* xsink);
+
+    // appends the length and data of a field
+    DLLLOCAL void addField(const void* data, int len);
+
+    // sends the buffered data if the buffer is full or if force is true; returns 0 for OK, -1 for error
+    DLLLOCAL int flush(ExceptionSink* xsink, bool force = false);
+};
+
+// receives the results of a query with COPY TO STDOUT and decodes them from the binary COPY format
+class QorePgsqlCopyOut : public QorePgsqlStatement {
+public:
+    DLLLOCAL QorePgsqlCopyOut(QorePGConnection* r_conn, const QoreEncoding* r_enc)
+            : QorePgsqlStatement(r_conn, r_enc) {
+    }
+
+    DLLLOCAL ~QorePgsqlCopyOut() {
+        if (cbuf)
+            PQfreemem(cbuf);
+    }
+
+    // starts the COPY for the given query; returns 0 for OK, -1 for error
+    DLLLOCAL int start(const QoreString& query, ExceptionSink* xsink);
+
+    // returns up to the given number of rows as a list of hashes, or nullptr if all rows have been read or an
+    // exception was raised
+    DLLLOCAL QoreListNode* fetchRows(int maxrows, ExceptionSink* xsink);
+
+    // returns up to the given number of rows as a hash of column lists, or nullptr if all rows have been read or an
+    // exception was raised
+    DLLLOCAL QoreHashNode* fetchColumns(int maxrows, ExceptionSink* xsink);
+
+    // stops the COPY; any rows not yet read are discarded
+    DLLLOCAL void abort();
+
+    // returns true if the COPY is in progress
+    DLLLOCAL bool active() const {
+        return conn->isCopyOwner(this);
+    }
+
+    DLLLOCAL int64 getRowCount() const {
+        return rows;
+    }
+
+    DLLLOCAL QorePGConnection* getConnection() const {
+        return conn;
+    }
+
+protected:
+    // the result columns
+    qore_pg_column_plan_t cols;
+    // the current buffer received from the server
+    char* cbuf = nullptr;
+    int clen = 0, cpos = 0;
+    // true once the file header has been read
+    bool header = false;
+    // the number of rows read
+    int64 rows = 0;
+
+    // decodes the next row, calling the function for each value; returns 1 if a row was read, 0 if all rows have
+    // been read, -1 for error
+    template <typename F>
+    DLLLOCAL int readRow(F f, ExceptionSink* xsink);
+
+    // makes sure that the given number of bytes is available in the current buffer; returns 0 for OK, -1 for error
+    DLLLOCAL int need(int bytes, ExceptionSink* xsink);
+
+    // reads the next buffer from the server; returns 1 if data was read, 0 at the end of the data, -1 for error
+    DLLLOCAL int getData(ExceptionSink* xsink);
+};
+
 class QorePGBindArray {
 private:
     int ndim, size, allocated, elements;
@@ -0,0 +1,302 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QorePGHandlePool.cpp
+
+    Qore Programming Language
+
+    Copyright 2003 - 2022 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "pgsql.h"
+#include "QorePGHandlePool.h"
+
+#if (defined _WIN32 || defined __WIN32__) && ! defined __CYGWIN__
+#include <winsock2.h>
+#else
+#include <poll.h>
+#endif
+
+#include <errno.h>
+
+#include <vector>
+
+QorePgsqlHandlePool qore_pg_handle_pool;
+
+PGconn* QorePgsqlHandlePool::get(const std::string& conninfo) {
+    std::vector<PGconn*> dead;
+    PGconn* pc = nullptr;
+    {
+        AutoLocker al(m);
+        if (max_idle && !stop) {
+            // the server is registered here so that connections are opened for it in advance if a minimum is set
+            server& s = server_map[conninfo];
+            while (!s.idle.empty()) {
+                PGconn* p = s.idle.front().pc;
+                s.idle.pop_front();
+                if (isAlive(p)) {
+                    pc = p;
+                    break;
+                }
+                dead.push_back(p);
+            }
+            if (pc)
+                ++hits;
+            else
+                ++misses;
+            // wake up the maintenance thread to replace the connection taken from the pool
+            if (min_idle)
+                cond.signal();
+        }
+    }
+
+    for (PGconn* p : dead)
+        PQfinish(p);
+    if (pc) {
+        // notifications received while the connection was idle belong to the previous user
+        discardNotifications(pc);
+        return pc;
+    }
+    return PQconnectdb(conninfo.c_str());
+}
+
+void QorePgsqlHandlePool::release(const std::string& conninfo, PGconn* pc, bool reusable) {
+    if (reusable && PQstatus(pc) == CONNECTION_OK && PQtransactionStatus(pc) == PQTRANS_IDLE) {
+        bool room;
+        {
+            AutoLocker al(m);
+            server_map_t::iterator i = server_map.find(conninfo);
+            room = max_idle && !stop && (i == server_map.end() || i->second.idle.size() < max_idle);
+        }
+        if (room) {
+            // the session state is reset so that the next user gets a clean session
+            if (resetSession(pc)) {
+                // notifications for channels the previous user listened on must not be seen by the next one
+                discardNotifications(pc);
+                AutoLocker al(m);
+                if (max_idle && !stop) {
+                    server& s = server_map[conninfo];
+                    if (s.idle.size() < max_idle) {
+                        s.idle.push_front({pc, std::chrono::steady_clock::now()});
+                        return;
+                    }
+                }
+            }
+        }
+    }
+    PQfinish(pc);
+}
+
+void QorePgsqlHandlePool::setLimits(unsigned n_min_idle, unsigned n_max_idle, int64 idle_timeout_ms) {
+    std::vector<PGconn*> to_close;
+    {
+        AutoLocker al(m);
+        if (stop)
+            return;
+        min_idle = n_min_idle;
+        max_idle = n_max_idle;
+        idle_timeout = idle_timeout_ms;
+
+        // close idle connections above the new maximum
+        for (auto& i : server_map) {
+            idle_list_t& idle = i.second.idle;
+            while (idle.size() > max_idle) {
+                to_close.push_back(idle.back().pc);
+                idle.pop_back();
+            }
+        }
+
+        if (max_idle && !maintenance.joinable())
+            maintenance = std::thread(&QorePgsqlHandlePool::run, this);
+        else
+            cond.signal();
+    }
+
+    for (PGconn* pc : to_close)
+        PQfinish(pc);
+}
+
+QoreHashNode* QorePgsqlHandlePool::getInfo(ExceptionSink* xsink) {
+    AutoLocker al(m);
+    int64 idle = 0;
+    for (auto& i : server_map)
+        idle += i.second.idle.size();
+
+    QoreHashNode* h = new QoreHashNode(autoTypeInfo);
+    h->setKeyValue("min", (int64)min_idle, xsink);
+    h->setKeyValue("max", (int64)max_idle, xsink);
+    h->setKeyValue("idle_timeout", idle_timeout, xsink);
+    h->setKeyValue("servers", (int64)server_map.size(), xsink);
+    h->setKeyValue("idle", idle, xsink);
+    h->setKeyValue("hits", hits, xsink);
+    h->setKeyValue("misses", misses, xsink);
+    return h;
+}
+
+void QorePgsqlHandlePool::clear() {
+    std::vector<PGconn*> to_close;
+    {
+        AutoLocker al(m);
+        // server entries are not removed, as the maintenance thread may be opening a connection for them
+        for (auto& i : server_map) {
+            for (auto& h : i.second.idle)
+                to_close.push_back(h.pc);
+            i.second.idle.clear();
+        }
+    }
+
+    for (PGconn* pc : to_close)
+        PQfinish(pc);
+}
+
+void QorePgsqlHandlePool::shutdown() {
+    {
+        AutoLocker al(m);
+        stop = true;
+        cond.signal();
+    }
+    if (maintenance.joinable())
+        maintenance.join();
+    clear();
+}
+
+void QorePgsqlHandlePool::discardNotifications(PGconn* pc) {
+    while (PGnotify* n = PQnotifies(pc))
+        PQfreemem(n);
+}
+
+bool QorePgsqlHandlePool::isAlive(PGconn* pc) {
+    if (PQstatus(pc) != CONNECTION_OK || PQtransactionStatus(pc) != PQTRANS_IDLE)
+        return false;
+
+    // an idle connection only has data to read if the server has closed it or sent a message; the message is read
+    // so that a closed connection can be detected without sending a command
+    int rc = waitRead(pc, 0);
+    if (rc < 0)
+        return false;
+    if (!rc)
+        return true;
+    return PQconsumeInput(pc) && PQstatus(pc) == CONNECTION_OK;
+}
+
+bool QorePgsqlHandlePool::resetSession(PGconn* pc) {
+    // the command is sent asynchronously so that a server that does not respond cannot block the thread releasing
+    // the connection
+    if (!PQsendQuery(pc, "discard all"))
+        return false;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(QORE_PG_POOL_RESET_TIMEOUT_MS);
+    bool ok = true;
+    while (true) {
+        while (PQisBusy(pc)) {
+            int64 remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline
+                - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0 || waitRead(pc, (int)remaining) <= 0 || !PQconsumeInput(pc)) {
+                printd(5, "QorePgsqlHandlePool::resetSession() pc: %p the session could not be reset in time\n", pc);
+                return false;
+            }
+        }
+        PGresult* res = PQgetResult(pc);
+        if (!res)
+            break;
+        if (PQresultStatus(res) != PGRES_COMMAND_OK)
+            ok = false;
+        PQclear(res);
+    }
+    return ok;
+}
+
+int QorePgsqlHandlePool::waitRead(PGconn* pc, int timeout_ms) {
+    pollfd fds;
+    fds.fd = PQsocket(pc);
+    fds.events = POLLIN;
+    fds.revents = 0;
+    while (true) {
+#if (defined _WIN32 || defined __WIN32__) && ! defined __CYGWIN__
+        int rc = WSAPoll(&fds, 1, timeout_ms);
+#else
+        int rc = poll(&fds, 1, timeout_ms);
+        if (rc < 0 && errno == EINTR)
+            continue;
+#endif
+        return rc < 0 ? -1 : (rc ? 1 : 0);
+    }
+}
+
+void QorePgsqlHandlePool::run() {
+    std::vector<PGconn*> to_close;
+    SafeLocker sl(m);
+    while (!stop) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        // idle connections above the minimum are closed after the idle timeout; the least recently used connections
+        // are at the end of the lists
+        for (auto& i : server_map) {
+            idle_list_t& idle = i.second.idle;
+            while (idle.size() > min_idle
+                && now - idle.back().since >= std::chrono::milliseconds(idle_timeout)) {
+                to_close.push_back(idle.back().pc);
+                idle.pop_back();
+            }
+        }
+
+        // find a server with fewer idle connections than the minimum; references to map elements remain valid
+        // when other elements are inserted
+        std::string conninfo;
+        server* s = nullptr;
+        if (max_idle) {
+            for (auto& i : server_map) {
+                if (i.second.idle.size() + i.second.warming < min_idle && now >= i.second.retry) {
+                    conninfo = i.first;
+                    s = &i.second;
+                    ++s->warming;
+                    break;
+                }
+            }
+        }
+
+        if (to_close.empty() && !s) {
+            // expired connections are checked at least once a second
+            cond.wait(&m, 1000);
+            continue;
+        }
+
+        sl.unlock();
+        for (PGconn* pc : to_close)
+            PQfinish(pc);
+        to_close.clear();
+        PGconn* pc = s ? PQconnectdb(conninfo.c_str()) : nullptr;
+        sl.lock();
+
+        if (s) {
+            --s->warming;
+            if (PQstatus(pc) != CONNECTION_OK) {
+                printd(5, "QorePgsqlHandlePool::run() failed to open a connection: %s\n", PQerrorMessage(pc));
+                s->retry = std::chrono::steady_clock::now() + std::chrono::milliseconds(QORE_PG_POOL_RETRY_MS);
+                if (pc)
+                    to_close.push_back(pc);
+            } else if (stop || s->idle.size() >= max_idle) {
+                to_close.push_back(pc);
+            } else {
+                s->idle.push_front({pc, std::chrono::steady_clock::now()});
+            }
+        }
+    }
+    sl.unlock();
+
+    for (PGconn* pc : to_close)
+        PQfinish(pc);
+}
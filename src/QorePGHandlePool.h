@@ -0,0 +1,121 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QorePGHandlePool.h
+
+    Qore Programming Language
+
+    Copyright 2003 - 2022 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _QORE_PGSQL_QOREPGHANDLEPOOL_H
+#define _QORE_PGSQL_QOREPGHANDLEPOOL_H
+
+#include "pgsql.h"
+
+#include <libpq-fe.h>
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <chrono>
+#include <thread>
+
+// the default time in milliseconds that idle connections above the minimum are kept in the pool
+#define QORE_PG_POOL_IDLE_TIMEOUT_DEFAULT 60000
+// the time in milliseconds to wait before trying to pre-connect to a server again after a failure
+#define QORE_PG_POOL_RETRY_MS 5000
+// the maximum time in milliseconds to wait for the session state of a connection returned to the pool to be reset;
+// the connection is closed if the reset does not complete in time
+#define QORE_PG_POOL_RESET_TIMEOUT_MS 1000
+
+// pool of idle server connections shared by all pgsql connections; connections are keyed by their connection
+// parameters, so a connection is only reused with exactly the same server, database, user, and options
+class QorePgsqlHandlePool {
+public:
+    DLLLOCAL ~QorePgsqlHandlePool() {
+        shutdown();
+    }
+
+    // returns an idle connection for the given parameters if one is available, otherwise a new connection
+    DLLLOCAL PGconn* get(const std::string& conninfo);
+
+    // returns a connection to the pool; the connection is closed if it cannot be reused or the pool is full
+    DLLLOCAL void release(const std::string& conninfo, PGconn* pc, bool reusable);
+
+    // sets the number of idle connections to keep for each server; the pool is disabled if max_idle is 0
+    DLLLOCAL void setLimits(unsigned min_idle, unsigned max_idle, int64 idle_timeout_ms);
+
+    // returns information about the pool
+    DLLLOCAL QoreHashNode* getInfo(ExceptionSink* xsink);
+
+    // closes all idle connections
+    DLLLOCAL void clear();
+
+    // stops the maintenance thread and closes all idle connections
+    DLLLOCAL void shutdown();
+
+private:
+    struct idle_handle {
+        PGconn* pc;
+        // the time the connection was returned to the pool
+        std::chrono::steady_clock::time_point since;
+    };
+    // the most recently used connection is at the front of the list
+    typedef std::list<idle_handle> idle_list_t;
+
+    struct server {
+        idle_list_t idle;
+        // the number of connections being opened by the maintenance thread
+        unsigned warming = 0;
+        // no connections are opened by the maintenance thread before this time after a failure
+        std::chrono::steady_clock::time_point retry;
+    };
+    typedef std::unordered_map<std::string, server> server_map_t;
+
+    QoreThreadLock m;
+    QoreCondition cond;
+    server_map_t server_map;
+    unsigned min_idle = 0,
+        max_idle = 0;
+    int64 idle_timeout = QORE_PG_POOL_IDLE_TIMEOUT_DEFAULT;
+    // the number of connections served from the pool and the number opened because the pool was empty
+    int64 hits = 0,
+        misses = 0;
+    // opens connections and closes expired idle connections in the background
+    std::thread maintenance;
+    bool stop = false;
+
+    // checks if an idle connection is still usable without a round trip to the server
+    DLLLOCAL static bool isAlive(PGconn* pc);
+
+    // frees any notifications queued in the connection
+    DLLLOCAL static void discardNotifications(PGconn* pc);
+
+    // resets the session state of a connection returned to the pool, waiting at most QORE_PG_POOL_RESET_TIMEOUT_MS;
+    // returns true if the connection can be reused
+    DLLLOCAL static bool resetSession(PGconn* pc);
+
+    // waits for data to be read from the connection; returns 1 if data can be read, 0 on timeout, -1 for error
+    DLLLOCAL static int waitRead(PGconn* pc, int timeout_ms);
+
+    // the maintenance thread's main loop
+    DLLLOCAL void run();
+};
+
+DLLLOCAL extern QorePgsqlHandlePool qore_pg_handle_pool;
+
+#endif
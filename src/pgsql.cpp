@@ -24,6 +24,12 @@
 
 #include "QorePGConnection.h"
 #include "QorePGMapper.h"
+#include "QorePGHandlePool.h"
+#include "QC_PgsqlConnection.h"
+#include "QC_PgsqlCopyIn.h"
+#include "QC_PgsqlCopyOut.h"
+#include "QC_PgsqlAsyncQuery.h"
+#include "QC_PgsqlLargeObject.h"
 
 #include <libpq-fe.h>
 
@@ -59,6 +65,7 @@ static int pgsql_caps = DBI_CAP_TRANSACTION_MANAGEMENT
    | DBI_CAP_HAS_NUMBER_SUPPORT
    |DBI_CAP_SERVER_TIME_ZONE
    |DBI_CAP_AUTORECONNECT
+   |DBI_CAP_HAS_ARRAY_BIND
 ;
 
 DBIDriver *DBID_PGSQL = NULL;
@@ -239,14 +246,14 @@ static QoreHashNode* pgsql_stmt_get_output(SQLStatement* stmt, ExceptionSink* xs
    QorePgsqlPreparedStatement* bg = (QorePgsqlPreparedStatement*)stmt->getPrivateData();
    assert(bg);
 
-   return bg->getOutputHash(xsink);
+   return bg->getOutput(xsink);
 }
 
 static QoreHashNode* pgsql_stmt_get_output_rows(SQLStatement* stmt, ExceptionSink* xsink) {
    QorePgsqlPreparedStatement* bg = (QorePgsqlPreparedStatement*)stmt->getPrivateData();
    assert(bg);
 
-   return bg->getOutputHash(xsink);
+   return bg->getOutput(xsink);
 }
 
 static QoreHashNode* pgsql_stmt_fetch_row(SQLStatement* stmt, ExceptionSink* xsink) {
@@ -281,7 +288,7 @@ static bool pgsql_stmt_next(SQLStatement* stmt, ExceptionSink* xsink) {
    QorePgsqlPreparedStatement* bg = (QorePgsqlPreparedStatement*)stmt->getPrivateData();
    assert(bg);
 
-   return bg->next();
+   return bg->next(xsink);
 }
 
 static int pgsql_stmt_close(SQLStatement* stmt, ExceptionSink* xsink) {
@@ -312,6 +319,11 @@ static QoreStringNode* pgsql_module_init() {
 
     init_pgsql_functions(pgsql_ns);
     init_pgsql_constants(pgsql_ns);
+    pgsql_ns.addSystemClass(initPgsqlConnectionClass(pgsql_ns));
+    pgsql_ns.addSystemClass(initPgsqlCopyInClass(pgsql_ns));
+    pgsql_ns.addSystemClass(initPgsqlCopyOutClass(pgsql_ns));
+    pgsql_ns.addSystemClass(initPgsqlAsyncQueryClass(pgsql_ns));
+    pgsql_ns.addSystemClass(initPgsqlLargeObjectClass(pgsql_ns));
 
     QorePGMapper::static_init();
     QorePgsqlStatement::static_init();
@@ -354,6 +366,14 @@ static QoreStringNode* pgsql_module_init() {
     methods.registerOption(DBI_OPT_NUMBER_OPT, "when set, numeric/decimal values are returned as integers if possible, otherwise as arbitrary-precision number values; the argument is ignored; setting this option turns it on and turns off 'string-numbers' and 'numeric-numbers'");
     methods.registerOption(DBI_OPT_NUMBER_STRING, "when set, numeric/decimal values are returned as strings for backwards-compatibility; the argument is ignored; setting this option turns it on and turns off 'optimal-numbers' and 'numeric-numbers'");
     methods.registerOption(DBI_OPT_NUMBER_NUMERIC, "when set, numeric/decimal values are returned as arbitrary-precision number values; the argument is ignored; setting this option turns it on and turns off 'string-numbers' and 'optimal-numbers'");
+    methods.registerOption(PGSQL_OPT_STATEMENT_CACHE_SIZE, "the maximum number of server-side prepared statements cached for SQL executed with the Datasource API (ex: Datasource::select()); the argument must be a non-negative integer; 0 (the default) disables the cache", softBigIntTypeInfo);
+    methods.registerOption(PGSQL_OPT_STREAM_RESULTS, "when set, rows are retrieved from the server as they are fetched with SQLStatement methods instead of retrieving the entire result set when the statement is executed", boolTypeInfo);
+    methods.registerOption(PGSQL_OPT_CURSOR_FETCH_ROWS, "when set to a positive integer, SQLStatement queries executed in a transaction use a server-side cursor and rows are fetched from the server in blocks of the given size as they are retrieved; 0 (the default) disables cursors", softBigIntTypeInfo);
+    methods.registerOption(PGSQL_OPT_QUERY_TIMEOUT, "the maximum time in milliseconds for a command to complete; when the timeout expires, the command is canceled on the server and a DBI:PGSQL:TIMEOUT exception is raised; 0 (the default) means no limit; transaction control commands are not affected", softBigIntTypeInfo);
+    methods.registerOption(PGSQL_OPT_RECONNECT_BACKOFF, "the time in milliseconds that reconnects to a server fail immediately after a failed reconnect, so that callers are not stalled while the server is unavailable; the time is doubled with each consecutive failure up to 30 seconds; 0 disables the backoff; the default is 1000", softBigIntTypeInfo);
+    methods.registerOption(PGSQL_OPT_RECONNECT_TIMEOUT, "the maximum time in milliseconds to wait for the connection to be reestablished after it has been lost; 0 (the default) means no limit", softBigIntTypeInfo);
+    methods.registerOption(PGSQL_OPT_DEFERRED_BEGIN, "when set, BEGIN is not sent to the server when a transaction is started but with the first command of the transaction, saving a network round trip per transaction", boolTypeInfo);
+    methods.registerOption(PGSQL_OPT_TYPED_COLUMNS, "when set, columns of integer, float, boolean, timestamp, and date types are returned in typed lists (ex: list<*int>) in results returned as hashes of lists, with NULL values returned as NOTHING", boolTypeInfo);
     methods.registerOption(DBI_OPT_TIMEZONE, "set the server-side timezone, value must be a string in the format accepted by Timezone::constructor() on the client (ie either a region name or a UTC offset like \"+01:00\"), if not set the server's time zone will be assumed to be the same as the client's", stringTypeInfo);
 
     DBID_PGSQL = DBI.registerDriver("pgsql", methods, pgsql_caps);
@@ -366,4 +386,5 @@ static void pgsql_module_ns_init(QoreNamespace* rns, QoreNamespace* qns) {
 }
 
 static void pgsql_module_delete() {
+    qore_pg_handle_pool.shutdown();
 }
@@ -1,4 +1,10 @@
 #include "QorePGConnection.cpp"
 #include "QorePGMapper.cpp"
+#include "QorePGHandlePool.cpp"
 #include "pgsql.cpp"
 #include "ql_pgsql.cpp"
+#include "QC_PgsqlConnection.cpp"
+#include "QC_PgsqlCopyIn.cpp"
+#include "QC_PgsqlCopyOut.cpp"
+#include "QC_PgsqlAsyncQuery.cpp"
+#include "QC_PgsqlLargeObject.cpp"